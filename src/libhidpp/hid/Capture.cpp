@@ -0,0 +1,209 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "Capture.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+using namespace HID;
+
+static constexpr const char *CaptureHeader = "hidpp-capture 1";
+
+static void writeBytes (std::ostream &out, std::span<const uint8_t> bytes)
+{
+	static constexpr char digits[] = "0123456789abcdef";
+	for (uint8_t byte: bytes)
+		out << digits[byte >> 4] << digits[byte & 0x0f];
+}
+
+static int hexDigit (char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static std::vector<uint8_t> parseBytes (const std::string &str)
+{
+	if (str.size () % 2 != 0)
+		throw std::runtime_error ("odd number of hexadecimal digits");
+	std::vector<uint8_t> bytes;
+	bytes.reserve (str.size () / 2);
+	for (std::size_t i = 0; i < str.size (); i += 2) {
+		int high = hexDigit (str[i]), low = hexDigit (str[i+1]);
+		if (high < 0 || low < 0)
+			throw std::runtime_error ("invalid hexadecimal digit");
+		bytes.push_back (high << 4 | low);
+	}
+	return bytes;
+}
+
+static Usage parseUsage (std::istream &in)
+{
+	uint32_t usage;
+	if (!(in >> std::hex >> usage >> std::dec))
+		throw std::runtime_error ("invalid usage");
+	return Usage (usage);
+}
+
+Capture Capture::load (const std::string &path)
+{
+	std::ifstream file (path);
+	if (!file)
+		throw std::runtime_error ("cannot open capture file " + path);
+
+	Capture capture = { 0, 0, {}, {}, {} };
+	ReportCollection *collection = nullptr;
+	std::vector<ReportField> *fields = nullptr;
+	bool has_header = false, has_device = false;
+	std::string line;
+	unsigned int line_number = 0;
+	while (std::getline (file, line)) {
+		++line_number;
+		if (line.empty () || line[0] == '#')
+			continue;
+		try {
+			if (!has_header) {
+				if (line != CaptureHeader)
+					throw std::runtime_error ("not a capture file");
+				has_header = true;
+				continue;
+			}
+			std::istringstream in (line);
+			std::string keyword;
+			in >> keyword;
+			if (keyword == "w" || keyword == "r") {
+				long long time;
+				std::string bytes;
+				if (!(in >> time >> bytes))
+					throw std::runtime_error ("invalid report");
+				capture.entries.push_back ({
+					keyword == "w" ? Entry::Write : Entry::Read,
+					std::chrono::microseconds (time),
+					parseBytes (bytes)
+				});
+			}
+			else if (keyword == "device") {
+				if (!(in >> std::hex >> capture.vendor_id >> capture.product_id >> std::dec))
+					throw std::runtime_error ("invalid device ids");
+				in >> std::ws;
+				std::getline (in, capture.name);
+				has_device = true;
+			}
+			else if (keyword == "collection") {
+				int type;
+				if (!(in >> type))
+					throw std::runtime_error ("invalid collection type");
+				auto usage = parseUsage (in);
+				collection = &capture.report_desc.collections.emplace_back (ReportCollection {
+					static_cast<ReportCollection::Type> (type), usage, {}
+				});
+				fields = nullptr;
+			}
+			else if (keyword == "report") {
+				int type;
+				unsigned int id;
+				if (!collection || !(in >> type >> id))
+					throw std::runtime_error ("invalid report");
+				fields = &collection->reports[ReportID { static_cast<ReportID::Type> (type), id }];
+			}
+			else if (keyword == "field") {
+				ReportField field;
+				std::string kind;
+				if (!fields || !(in >> std::hex >> field.flags.bits >> std::dec >> field.count >> field.size >> kind))
+					throw std::runtime_error ("invalid field");
+				if (kind == "usages") {
+					std::vector<Usage> usages;
+					while (in >> std::ws, !in.eof ())
+						usages.push_back (parseUsage (in));
+					field.usages = std::move (usages);
+				}
+				else if (kind == "range") {
+					auto first = parseUsage (in);
+					auto last = parseUsage (in);
+					field.usages = std::make_pair (first, last);
+				}
+				else
+					throw std::runtime_error ("invalid field usages");
+				fields->push_back (std::move (field));
+			}
+			else
+				throw std::runtime_error ("unknown keyword \"" + keyword + "\"");
+		}
+		catch (std::runtime_error &e) {
+			throw std::runtime_error (path + ":" + std::to_string (line_number) + ": " + e.what ());
+		}
+	}
+	if (!has_header || !has_device)
+		throw std::runtime_error (path + ": incomplete capture file");
+	return capture;
+}
+
+CaptureWriter::CaptureWriter (const std::string &path,
+			      uint16_t vendor_id, uint16_t product_id,
+			      const std::string &name,
+			      const ReportDescriptor &report_desc):
+	_file (path),
+	_start (std::chrono::steady_clock::now ())
+{
+	if (!_file)
+		throw std::runtime_error ("cannot create capture file " + path);
+	char ids[16];
+	snprintf (ids, sizeof (ids), "%04x %04x", vendor_id, product_id);
+	_file << CaptureHeader << "\n";
+	_file << "device " << ids << " " << name << "\n";
+	_file << std::hex;
+	for (const auto &collection: report_desc.collections) {
+		_file << "collection " << int (collection.type) << " " << uint32_t (collection.usage) << "\n";
+		for (const auto &[id, fields]: collection.reports) {
+			_file << "report " << std::dec << int (id.type) << " " << id.id << std::hex << "\n";
+			for (const auto &f: fields) {
+				_file << "field " << f.flags.bits << std::dec << " " << f.count << " " << f.size << std::hex;
+				if (auto usages = std::get_if<std::vector<Usage>> (&f.usages)) {
+					_file << " usages";
+					for (auto usage: *usages)
+						_file << " " << uint32_t (usage);
+				}
+				else {
+					const auto &range = std::get<std::pair<Usage, Usage>> (f.usages);
+					_file << " range " << uint32_t (range.first) << " " << uint32_t (range.second);
+				}
+				_file << "\n";
+			}
+		}
+	}
+	_file << std::dec << std::flush;
+}
+
+void CaptureWriter::record (Capture::Entry::Direction direction,
+			    std::span<const uint8_t> report,
+			    std::chrono::steady_clock::time_point time)
+{
+	auto us = std::chrono::duration_cast<std::chrono::microseconds> (time - _start);
+	std::unique_lock<std::mutex> lock (_mutex);
+	_file << (direction == Capture::Entry::Write ? "w " : "r ") << us.count () << " ";
+	writeBytes (_file, report);
+	// Flush every report so the capture is usable even if the program
+	// does not exit cleanly.
+	_file << std::endl;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LIBHIDPP_HID_CAPTURE_H
+#define LIBHIDPP_HID_CAPTURE_H
+
+#include <hid/ReportDescriptor.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace HID
+{
+
+/**
+ * Recording of the reports exchanged with a HID device.
+ *
+ * Capture files are text files describing the device followed by one
+ * line per report:
+ * \code
+ * hidpp-capture 1
+ * device <vendor id> <product id> <name>
+ * collection <type> <usage>
+ * report <type> <id>
+ * field <flags> <count> <size> usages <usage>...
+ * field <flags> <count> <size> range <first usage> <last usage>
+ * w <time> <report>
+ * r <time> <report>
+ * \endcode
+ * Ids, usages and flags are hexadecimal. Collection and report types
+ * use the numeric values of ReportCollection::Type and ReportID::Type.
+ * \c w lines are reports written to the device, \c r lines reports read
+ * from it. Times are microseconds since the start of the capture and
+ * reports are hexadecimal bytes without separators. Empty lines and
+ * lines starting with \c # are ignored.
+ */
+struct Capture
+{
+	struct Entry
+	{
+		enum Direction {
+			Write,
+			Read,
+		} direction;
+		std::chrono::microseconds time;
+		std::vector<uint8_t> report;
+	};
+
+	uint16_t vendor_id, product_id;
+	std::string name;
+	ReportDescriptor report_desc;
+	std::vector<Entry> entries;
+
+	/**
+	 * Parse the capture file \p path.
+	 *
+	 * \throws std::runtime_error if the file cannot be read or is malformed.
+	 */
+	static Capture load (const std::string &path);
+};
+
+/**
+ * Thread-safe writer for capture files.
+ */
+class CaptureWriter
+{
+public:
+	/**
+	 * Create the capture file \p path and write the device description.
+	 */
+	CaptureWriter (const std::string &path,
+		       uint16_t vendor_id, uint16_t product_id,
+		       const std::string &name,
+		       const ReportDescriptor &report_desc);
+
+	/**
+	 * Append a report that was read or written at \p time.
+	 */
+	void record (Capture::Entry::Direction direction,
+		     std::span<const uint8_t> report,
+		     std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now ());
+
+private:
+	std::mutex _mutex;
+	std::ofstream _file;
+	std::chrono::steady_clock::time_point _start;
+};
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "DeviceMonitor.h"
+
+#include <misc/Log.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace HID;
+
+/*
+ * Devices are the capture files named by the HIDPP_REPLAY environment
+ * variable: either a single file or a directory containing ".cap" files.
+ */
+struct DeviceMonitor::PrivateImpl
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool stopped = false;
+};
+
+DeviceMonitor::DeviceMonitor ():
+	_p (std::make_unique<PrivateImpl> ())
+{
+}
+
+DeviceMonitor::~DeviceMonitor ()
+{
+}
+
+void DeviceMonitor::enumerate ()
+{
+	const char *env = std::getenv ("HIDPP_REPLAY");
+	if (!env || !*env) {
+		Log::warning ("hid") << "HIDPP_REPLAY is not set, no capture to replay." << std::endl;
+		return;
+	}
+	std::filesystem::path path (env);
+	if (!std::filesystem::is_directory (path)) {
+		addDevice (path.string ().c_str ());
+		return;
+	}
+	std::vector<std::string> files;
+	for (const auto &entry: std::filesystem::directory_iterator (path))
+		if (entry.is_regular_file () && entry.path ().extension () == ".cap")
+			files.push_back (entry.path ().string ());
+	std::sort (files.begin (), files.end ());
+	for (const auto &file: files)
+		addDevice (file.c_str ());
+}
+
+void DeviceMonitor::run ()
+{
+	enumerate ();
+	// Captured devices are never added or removed, wait for stop.
+	std::unique_lock<std::mutex> lock (_p->mutex);
+	_p->cond.wait (lock, [this] () { return _p->stopped; });
+	_p->stopped = false;
+}
+
+void DeviceMonitor::stop ()
+{
+	{
+		std::unique_lock<std::mutex> lock (_p->mutex);
+		_p->stopped = true;
+	}
+	_p->cond.notify_all ();
+}
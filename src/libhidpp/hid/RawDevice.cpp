@@ -20,8 +20,62 @@
 
 #include <misc/Log.h>
 
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
+
 using namespace HID;
 
+void RawDevice::setRawTimestamps (bool enabled)
+{
+	_raw_timestamps = enabled;
+}
+
+Timestamp RawDevice::currentTime () const
+{
+	Timestamp timestamp = { std::chrono::steady_clock::now (), {} };
+#ifdef CLOCK_MONOTONIC_RAW
+	if (_raw_timestamps) {
+		struct timespec ts;
+		if (0 == clock_gettime (CLOCK_MONOTONIC_RAW, &ts))
+			timestamp.monotonic_raw = std::chrono::seconds (ts.tv_sec) + std::chrono::nanoseconds (ts.tv_nsec);
+	}
+#endif
+	return timestamp;
+}
+
+void RawDevice::startCapture (const std::string &path)
+{
+	_capture = std::make_unique<CaptureWriter> (path, _vendor_id, _product_id, _name, _report_desc);
+	Log::info ().printf ("Capturing reports from \"%s\" in %s\n", _name.c_str (), path.c_str ());
+}
+
+void RawDevice::stopCapture ()
+{
+	_capture.reset ();
+}
+
+void RawDevice::startCaptureFromEnvironment (const std::string &path)
+{
+	const char *dir = std::getenv ("HIDPP_CAPTURE");
+	if (!dir || !*dir)
+		return;
+	// Build a file name from the device path, e.g. /dev/hidraw0 -> dev_hidraw0.cap
+	std::string filename;
+	for (char c: path) {
+		if (std::isalnum (static_cast<unsigned char> (c)) || c == '-' || c == '.')
+			filename.push_back (c);
+		else if (!filename.empty () && filename.back () != '_')
+			filename.push_back ('_');
+	}
+	try {
+		startCapture (std::string (dir) + "/" + filename + ".cap");
+	}
+	catch (std::exception &e) {
+		Log::error () << "Failed to start capture: " << e.what () << std::endl;
+	}
+}
+
 void RawDevice::logReportDescriptor () const
 {
 	auto debug = Log::debug ("reportdesc");
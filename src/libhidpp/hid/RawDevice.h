@@ -19,11 +19,16 @@
 #ifndef LIBHIDPP_HID_RAW_DEVICE_H
 #define LIBHIDPP_HID_RAW_DEVICE_H
 
+#include <atomic>
 #include <string>
+#include <span>
 #include <vector>
 #include <memory>
 
+#include <hid/Capture.h>
 #include <hid/ReportDescriptor.h>
+#include <hid/ReportRing.h>
+#include <hid/Timestamp.h>
 
 namespace HID
 {
@@ -53,21 +58,74 @@ public:
 		return _report_desc;
 	}
 
-	int writeReport (const std::vector<uint8_t> &report);
+	int writeReport (std::span<const uint8_t> report);
 
 	/**
-	 * \param[out]	report	HID report
+	 * Read a report into \p report.
+	 *
+	 * \p report must be large enough for any input report of the device.
+	 *
+	 * \param[out]	report	HID report buffer
 	 * \param[in]	timeout	Time-out in milliseconds, negative for no timeout.
+	 * \param[out]	timestamp	If not null, set to the time the report was read.
 	 *
 	 * \returns report size or 0 if interrupted or timed out.
 	 */
-	int readReport (std::vector<uint8_t> &report, int timeout = -1);
+	int readReport (std::span<uint8_t> report, int timeout = -1, Timestamp *timestamp = nullptr);
+
+	/**
+	 * Read all the reports already queued into \p reports.
+	 *
+	 * Waits for at least one report like readReport, then reads the
+	 * following reports without blocking until none is left or \p reports
+	 * is full. With the Linux backend, a whole batch costs one wait and
+	 * one read per report.
+	 *
+	 * Each report is timestamped as soon as it is read.
+	 *
+	 * \param[out]	reports	Ring receiving the reports, its report
+	 *			size must be large enough for any input report
+	 *			of the device.
+	 * \param[in]	timeout	Time-out in milliseconds, negative for no timeout.
+	 *
+	 * \returns the number of reports added, 0 if interrupted, timed out
+	 * or \p reports is full.
+	 */
+	std::size_t readReports (ReportRing &reports, int timeout = -1);
+
+	/**
+	 * Also stamp reports with CLOCK_MONOTONIC_RAW (Linux backend only).
+	 *
+	 * It may be called while another thread is reading.
+	 */
+	void setRawTimestamps (bool enabled);
+
+	/**
+	 * Record every report written to or read from the device in the
+	 * capture file \p path (see Capture).
+	 *
+	 * A capture is also started when the device is opened if the
+	 * HIDPP_CAPTURE environment variable is set: it names the directory
+	 * where the capture file is created.
+	 *
+	 * It must not be called while another thread is using the device.
+	 */
+	void startCapture (const std::string &path);
+	void stopCapture ();
 
 	/**
 	 * Interrupts the current (or next) readReport call so it returns immediately.
 	 */
 	void interruptRead ();
 
+	/**
+	 * Get the file descriptor of the HID device for waiting on input
+	 * reports with poll, select or epoll.
+	 *
+	 * Only available with the Linux backend.
+	 */
+	int fileDescriptor () const;
+
 private:
 	RawDevice ();
 
@@ -77,8 +135,12 @@ private:
 	uint16_t _vendor_id, _product_id;
 	std::string _name;
 	ReportDescriptor _report_desc;
+	std::atomic<bool> _raw_timestamps = false;
+	std::unique_ptr<CaptureWriter> _capture;
 
 	void logReportDescriptor () const;
+	Timestamp currentTime () const;
+	void startCaptureFromEnvironment (const std::string &path);
 };
 
 }
@@ -20,6 +20,8 @@
 
 #include <misc/Log.h>
 
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
 extern "C" {
@@ -47,7 +49,9 @@ RawDevice::RawDevice ():
 RawDevice::RawDevice (const std::string &path):
 	_p (std::make_unique<PrivateImpl> ())
 {
-	_p->fd = ::open (path.c_str (), O_RDWR);
+	// Reads always wait with select first, the non-blocking mode lets
+	// readReports drain the queue without waiting.
+	_p->fd = ::open (path.c_str (), O_RDWR | O_NONBLOCK);
 	if (_p->fd == -1) {
 		throw std::system_error (errno, std::system_category (), "open");
 	}
@@ -96,6 +100,8 @@ RawDevice::RawDevice (const std::string &path):
 		::close (_p->fd);
 		throw std::system_error (err, std::system_category (), "pipe");
 	}
+
+	startCaptureFromEnvironment (path);
 }
 
 RawDevice::RawDevice (const RawDevice &other):
@@ -119,7 +125,8 @@ RawDevice::RawDevice (RawDevice &&other):
 	_p (std::make_unique<PrivateImpl> ()),
 	_vendor_id (other._vendor_id), _product_id (other._product_id),
 	_name (std::move (other._name)),
-	_report_desc (std::move (other._report_desc))
+	_report_desc (std::move (other._report_desc)),
+	_capture (std::move (other._capture))
 {
 	_p->fd = other._p->fd;
 	_p->pipe[0] = other._p->pipe[0];
@@ -136,46 +143,118 @@ RawDevice::~RawDevice ()
 	}
 }
 
-int RawDevice::writeReport (const std::vector<uint8_t> &report)
+int RawDevice::writeReport (std::span<const uint8_t> report)
 {
 	int ret = write (_p->fd, report.data (), report.size ());
 	if (ret == -1) {
 		throw std::system_error (errno, std::system_category (), "write");
 	}
 	Log::debug ("report").printBytes ("Send HID report:", report.begin (), report.end ());
+	if (_capture)
+		_capture->record (Capture::Entry::Write, report.first (ret));
 	return ret;
 }
 
-int RawDevice::readReport (std::vector<uint8_t> &report, int timeout)
+/**
+ * Wait for \p fd or \p pipe to be readable.
+ *
+ * \returns true if \p fd is readable, false if timed out or interrupted.
+ */
+static bool waitForReport (int fd, int pipe, int timeout)
 {
 	int ret;
 	timeval to = { timeout/1000, (timeout%1000) * 1000 };
 	fd_set fds;
 	do {
 		FD_ZERO (&fds);
-		FD_SET (_p->fd, &fds);
-		FD_SET (_p->pipe[0], &fds);
-		ret = select (std::max (_p->fd, _p->pipe[0])+1,
+		FD_SET (fd, &fds);
+		FD_SET (pipe, &fds);
+		ret = select (std::max (fd, pipe)+1,
 				&fds, nullptr, nullptr,
 				(timeout < 0 ? nullptr : &to));
 	} while (ret == -1 && errno == EINTR);
 	if (ret == -1)
 		throw std::system_error (errno, std::system_category (), "select");
-	if (FD_ISSET (_p->fd, &fds)) {
-		ret = read (_p->fd, report.data (), report.size ());
-		if (ret == -1)
-			throw std::system_error (errno, std::system_category (), "read");
-		report.resize (ret);
-		Log::debug ("report").printBytes ("Recv HID report:", report.begin (), report.end ());
-		return ret;
-	}
-	if (FD_ISSET (_p->pipe[0], &fds)) {
+	if (FD_ISSET (fd, &fds))
+		return true;
+	if (FD_ISSET (pipe, &fds)) {
 		char c;
-		ret = read (_p->pipe[0], &c, sizeof (char));
+		ret = read (pipe, &c, sizeof (char));
 		if (ret == -1)
 			throw std::system_error (errno, std::system_category (), "read pipe");
 	}
-	return 0;
+	return false;
+}
+
+/**
+ * Timeout for waiting again until \p deadline, \p timeout is the
+ * initial timeout and negative timeouts do not expire.
+ */
+static int remainingTimeout (int timeout, std::chrono::steady_clock::time_point deadline)
+{
+	if (timeout < 0)
+		return timeout;
+	auto remaining = std::chrono::ceil<std::chrono::milliseconds> (
+		deadline - std::chrono::steady_clock::now ());
+	return std::max<int> (0, remaining.count ());
+}
+
+int RawDevice::readReport (std::span<uint8_t> report, int timeout, Timestamp *timestamp)
+{
+	auto deadline = std::chrono::steady_clock::now () + std::chrono::milliseconds (timeout);
+	int ret;
+	while (true) {
+		if (!waitForReport (_p->fd, _p->pipe[0], remainingTimeout (timeout, deadline)))
+			return 0;
+		ret = read (_p->fd, report.data (), report.size ());
+		if (ret != -1)
+			break;
+		// EAGAIN is a spurious wake-up, wait again until the deadline.
+		if (errno != EAGAIN)
+			throw std::system_error (errno, std::system_category (), "read");
+	}
+	auto now = currentTime ();
+	if (timestamp)
+		*timestamp = now;
+	Log::debug ("report").printBytes ("Recv HID report:", report.begin (), report.begin () + ret);
+	if (_capture)
+		_capture->record (Capture::Entry::Read, report.first (ret), now.monotonic);
+	return ret;
+}
+
+std::size_t RawDevice::readReports (ReportRing &reports, int timeout)
+{
+	if (reports.full ())
+		return 0;
+	auto deadline = std::chrono::steady_clock::now () + std::chrono::milliseconds (timeout);
+	if (!waitForReport (_p->fd, _p->pipe[0], timeout))
+		return 0;
+	auto debug = Log::debug ("report");
+	std::size_t count = 0;
+	while (!reports.full ()) {
+		auto buffer = reports.back ();
+		int ret = read (_p->fd, buffer.data (), buffer.size ());
+		if (ret == -1) {
+			if (errno == EAGAIN) {
+				if (count > 0)
+					break; // the queue is drained
+				// Spurious wake-up, wait again until the deadline.
+				if (!waitForReport (_p->fd, _p->pipe[0], remainingTimeout (timeout, deadline)))
+					return 0;
+				continue;
+			}
+			if (count > 0)
+				break; // return the reports already read, the error will be reported on the next call
+			throw std::system_error (errno, std::system_category (), "read");
+		}
+		auto timestamp = currentTime ();
+		debug.printBytes ("Recv HID report:", buffer.begin (), buffer.begin () + ret);
+		if (_capture)
+			_capture->record (Capture::Entry::Read, buffer.first (ret), timestamp.monotonic);
+		reports.push (ret, timestamp);
+		++count;
+	}
+	return count;
 }
 
 void RawDevice::interruptRead ()
@@ -184,3 +263,8 @@ void RawDevice::interruptRead ()
 	if (-1 == write (_p->pipe[1], &c, sizeof (char)))
 		throw std::system_error (errno, std::system_category (), "write pipe");
 }
+
+int RawDevice::fileDescriptor () const
+{
+	return _p->fd;
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "RawDevice.h"
+
+#include <misc/Log.h>
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+using namespace HID;
+
+/*
+ * Replays a capture file (see Capture) as if it was the device.
+ *
+ * Reports recorded before the first write are queued when the device is
+ * opened. Each written report is matched with the first recorded write
+ * with the same content that was not replayed yet, the reports recorded
+ * after it (until the next write) are then queued with the same delays
+ * as in the capture.
+ *
+ * Delays are divided by the HIDPP_REPLAY_SPEED environment variable
+ * (default is 1, 0 replays without any delay).
+ */
+struct RawDevice::PrivateImpl
+{
+	typedef std::chrono::steady_clock clock;
+
+	std::vector<Capture::Entry> entries;
+	std::vector<std::size_t> writes; // indices of written reports in entries
+	std::vector<bool> replayed; // for each element in writes
+	std::size_t first_write; // first write not yet replayed
+	double speed;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::multimap<clock::time_point, std::size_t> pending; // due time -> entry index
+	bool interrupted;
+
+	PrivateImpl (Capture &&capture):
+		entries (std::move (capture.entries)),
+		first_write (0),
+		speed (1.0),
+		interrupted (false)
+	{
+		for (std::size_t i = 0; i < entries.size (); ++i)
+			if (entries[i].direction == Capture::Entry::Write)
+				writes.push_back (i);
+		replayed.resize (writes.size (), false);
+		if (const char *env = std::getenv ("HIDPP_REPLAY_SPEED"))
+			speed = std::strtod (env, nullptr);
+		queueReads (0, clock::now (), {});
+	}
+
+	clock::duration scaled (std::chrono::microseconds delay) const
+	{
+		if (speed <= 0.0)
+			return clock::duration::zero ();
+		return std::chrono::duration_cast<clock::duration> (
+				std::chrono::duration<double, std::micro> (delay.count () / speed));
+	}
+
+	// mutex must be locked
+	void queueReads (std::size_t first, clock::time_point start, std::chrono::microseconds start_time)
+	{
+		for (std::size_t i = first; i < entries.size () && entries[i].direction == Capture::Entry::Read; ++i)
+			pending.emplace (start + scaled (entries[i].time - start_time), i);
+	}
+
+	// mutex must be locked
+	bool replayWrite (std::span<const uint8_t> report)
+	{
+		for (std::size_t i = first_write; i < writes.size (); ++i) {
+			const auto &entry = entries[writes[i]];
+			if (replayed[i] || !std::equal (report.begin (), report.end (),
+							entry.report.begin (), entry.report.end ()))
+				continue;
+			replayed[i] = true;
+			while (first_write < writes.size () && replayed[first_write])
+				++first_write;
+			queueReads (writes[i]+1, clock::now (), entry.time);
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Wait until a queued report is due.
+	 *
+	 * \returns false if timed out or interrupted.
+	 */
+	bool wait (std::unique_lock<std::mutex> &lock, int timeout)
+	{
+		auto deadline = timeout < 0
+			? clock::time_point::max ()
+			: clock::now () + std::chrono::milliseconds (timeout);
+		while (true) {
+			if (interrupted) {
+				interrupted = false;
+				return false;
+			}
+			auto now = clock::now ();
+			if (!pending.empty () && pending.begin ()->first <= now)
+				return true;
+			if (now >= deadline)
+				return false;
+			auto wake_up = deadline;
+			if (!pending.empty ())
+				wake_up = std::min (wake_up, pending.begin ()->first);
+			if (wake_up == clock::time_point::max ())
+				cond.wait (lock);
+			else
+				cond.wait_until (lock, wake_up);
+		}
+	}
+
+	/**
+	 * Copy the next due report in \p report, mutex must be locked.
+	 *
+	 * \returns the report size or 0 if no report is due.
+	 */
+	int pop (std::span<uint8_t> report)
+	{
+		if (pending.empty () || pending.begin ()->first > clock::now ())
+			return 0;
+		const auto &data = entries[pending.begin ()->second].report;
+		if (data.size () > report.size ())
+			throw std::runtime_error ("Replayed report is too large for the buffer");
+		std::copy (data.begin (), data.end (), report.begin ());
+		pending.erase (pending.begin ());
+		return data.size ();
+	}
+};
+
+RawDevice::RawDevice ()
+{
+}
+
+RawDevice::RawDevice (const std::string &path)
+{
+	auto capture = Capture::load (path);
+	_vendor_id = capture.vendor_id;
+	_product_id = capture.product_id;
+	_name = std::move (capture.name);
+	_report_desc = std::move (capture.report_desc);
+	_p = std::make_unique<PrivateImpl> (std::move (capture));
+	Log::debug ("hid").printf ("Opened replay of \"%s\" (%04x:%04x) from %s\n",
+			_name.c_str (), _vendor_id, _product_id, path.c_str ());
+	logReportDescriptor ();
+
+	startCaptureFromEnvironment (path);
+}
+
+RawDevice::RawDevice (const RawDevice &other):
+	_vendor_id (other._vendor_id), _product_id (other._product_id),
+	_name (other._name),
+	_report_desc (other._report_desc)
+{
+	// The copy replays the capture from the beginning, entries are
+	// never modified after loading.
+	Capture capture = { _vendor_id, _product_id, _name, _report_desc, other._p->entries };
+	_p = std::make_unique<PrivateImpl> (std::move (capture));
+}
+
+RawDevice::RawDevice (RawDevice &&other):
+	_p (std::move (other._p)),
+	_vendor_id (other._vendor_id), _product_id (other._product_id),
+	_name (std::move (other._name)),
+	_report_desc (std::move (other._report_desc)),
+	_capture (std::move (other._capture))
+{
+}
+
+RawDevice::~RawDevice ()
+{
+}
+
+int RawDevice::writeReport (std::span<const uint8_t> report)
+{
+	bool replayed;
+	{
+		std::unique_lock<std::mutex> lock (_p->mutex);
+		replayed = _p->replayWrite (report);
+	}
+	if (replayed)
+		_p->cond.notify_all ();
+	else
+		Log::warning ("hid").printf ("Written report was not found in the capture of \"%s\"\n", _name.c_str ());
+	Log::debug ("report").printBytes ("Send HID report:", report.begin (), report.end ());
+	if (_capture)
+		_capture->record (Capture::Entry::Write, report);
+	return report.size ();
+}
+
+int RawDevice::readReport (std::span<uint8_t> report, int timeout, Timestamp *timestamp)
+{
+	int ret;
+	{
+		std::unique_lock<std::mutex> lock (_p->mutex);
+		if (!_p->wait (lock, timeout))
+			return 0;
+		ret = _p->pop (report);
+	}
+	auto now = currentTime ();
+	if (timestamp)
+		*timestamp = now;
+	Log::debug ("report").printBytes ("Recv HID report:", report.begin (), report.begin () + ret);
+	if (_capture)
+		_capture->record (Capture::Entry::Read, report.first (ret), now.monotonic);
+	return ret;
+}
+
+std::size_t RawDevice::readReports (ReportRing &reports, int timeout)
+{
+	std::unique_lock<std::mutex> lock (_p->mutex);
+	if (reports.full () || !_p->wait (lock, timeout))
+		return 0;
+	auto debug = Log::debug ("report");
+	std::size_t count = 0;
+	while (!reports.full ()) {
+		auto buffer = reports.back ();
+		int ret = _p->pop (buffer);
+		if (ret == 0)
+			break;
+		auto timestamp = currentTime ();
+		debug.printBytes ("Recv HID report:", buffer.begin (), buffer.begin () + ret);
+		if (_capture)
+			_capture->record (Capture::Entry::Read, buffer.first (ret), timestamp.monotonic);
+		reports.push (ret, timestamp);
+		++count;
+	}
+	return count;
+}
+
+void RawDevice::interruptRead ()
+{
+	{
+		std::unique_lock<std::mutex> lock (_p->mutex);
+		_p->interrupted = true;
+	}
+	_p->cond.notify_all ();
+}
@@ -306,6 +306,8 @@ RawDevice::RawDevice (const std::string &path):
 		throw std::system_error (err, windows_category (),
 					 "CreateEvent");
 	}
+
+	startCaptureFromEnvironment (path);
 }
 
 RawDevice::RawDevice (const RawDevice &other):
@@ -349,7 +351,8 @@ RawDevice::RawDevice (RawDevice &&other):
 	_p (std::make_unique<PrivateImpl> ()),
 	_vendor_id (other._vendor_id), _product_id (other._product_id),
 	_name (std::move (other._name)),
-	_report_desc (std::move (other._report_desc))
+	_report_desc (std::move (other._report_desc)),
+	_capture (std::move (other._capture))
 {
 	std::swap (_p, other._p);
 }
@@ -358,7 +361,7 @@ RawDevice::~RawDevice ()
 {
 }
 
-int RawDevice::writeReport (const std::vector<uint8_t> &report)
+int RawDevice::writeReport (std::span<const uint8_t> report)
 {
 	DWORD err, written;
 	OVERLAPPED overlapped;
@@ -381,6 +384,8 @@ int RawDevice::writeReport (const std::vector<uint8_t> &report)
 			throw std::system_error (err, windows_category (), "WriteFile");
 	}
 	Log::debug ("report").printBytes ("Send HID report:", report.begin (), report.end ());
+	if (_capture)
+		_capture->record (Capture::Entry::Write, report.first (written));
 	return written;
 }
 
@@ -435,7 +440,7 @@ public:
 	}
 };
 
-int RawDevice::readReport (std::vector<uint8_t> &report, int timeout)
+int RawDevice::readReport (std::span<uint8_t> report, int timeout, Timestamp *timestamp)
 {
 	DWORD err, read, ret, i;
 	assert (_p->interrupted_event != INVALID_HANDLE_VALUE);
@@ -468,11 +473,27 @@ int RawDevice::readReport (std::vector<uint8_t> &report, int timeout)
 			reads[i].finish (&read);
 	}
 report_read:
-	report.resize (read);
-	Log::debug ("report").printBytes ("Recv HID report:", report.begin (), report.end ());
+	auto now = currentTime ();
+	if (timestamp)
+		*timestamp = now;
+	Log::debug ("report").printBytes ("Recv HID report:", report.begin (), report.begin () + read);
+	if (_capture)
+		_capture->record (Capture::Entry::Read, report.first (read), now.monotonic);
 	return read;
 }
 
+std::size_t RawDevice::readReports (ReportRing &reports, int timeout)
+{
+	if (reports.full ())
+		return 0;
+	Timestamp timestamp;
+	int ret = readReport (reports.back (), timeout, &timestamp);
+	if (ret == 0)
+		return 0;
+	reports.push (ret, timestamp);
+	return 1;
+}
+
 void RawDevice::interruptRead ()
 {
 	DWORD err;
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ReportRing.h"
+
+#include <cassert>
+
+using namespace HID;
+
+ReportRing::ReportRing (std::size_t capacity, std::size_t report_size):
+	_report_size (report_size),
+	_data (capacity*report_size),
+	_lengths (capacity),
+	_timestamps (capacity),
+	_head (0),
+	_count (0)
+{
+}
+
+std::size_t ReportRing::capacity () const
+{
+	return _lengths.size ();
+}
+
+std::size_t ReportRing::size () const
+{
+	return _count;
+}
+
+bool ReportRing::empty () const
+{
+	return _count == 0;
+}
+
+bool ReportRing::full () const
+{
+	return _count == _lengths.size ();
+}
+
+std::span<uint8_t> ReportRing::back ()
+{
+	assert (!full ());
+	auto slot = (_head + _count) % _lengths.size ();
+	return std::span<uint8_t> (&_data[slot*_report_size], _report_size);
+}
+
+void ReportRing::push (std::size_t length, const Timestamp &timestamp)
+{
+	assert (!full () && length <= _report_size);
+	auto slot = (_head + _count) % _lengths.size ();
+	_lengths[slot] = length;
+	_timestamps[slot] = timestamp;
+	++_count;
+}
+
+std::span<const uint8_t> ReportRing::front () const
+{
+	assert (!empty ());
+	return std::span<const uint8_t> (&_data[_head*_report_size], _lengths[_head]);
+}
+
+const Timestamp &ReportRing::frontTimestamp () const
+{
+	assert (!empty ());
+	return _timestamps[_head];
+}
+
+void ReportRing::pop ()
+{
+	assert (!empty ());
+	_head = (_head + 1) % _lengths.size ();
+	--_count;
+}
+
+void ReportRing::clear ()
+{
+	_head = _count = 0;
+}
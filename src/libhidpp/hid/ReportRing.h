@@ -0,0 +1,94 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HID_REPORT_RING_H
+#define LIBHIDPP_HID_REPORT_RING_H
+
+#include <hid/Timestamp.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace HID
+{
+
+/**
+ * Fixed-capacity FIFO of raw HID reports.
+ *
+ * Memory is allocated once by the constructor, pushing and popping
+ * reports never allocates.
+ */
+class ReportRing
+{
+public:
+	/**
+	 * \param capacity	Maximum number of reports
+	 * \param report_size	Maximum size of a report
+	 */
+	ReportRing (std::size_t capacity, std::size_t report_size);
+
+	std::size_t capacity () const;
+	std::size_t size () const;
+	bool empty () const;
+	bool full () const;
+
+	/**
+	 * Free buffer at the back of the ring.
+	 *
+	 * The ring must not be full. The data is only added to the ring
+	 * when calling push.
+	 */
+	std::span<uint8_t> back ();
+	/**
+	 * Add the first \p length bytes written in back() as a new report
+	 * received at \p timestamp.
+	 */
+	void push (std::size_t length, const Timestamp &timestamp = {});
+
+	/**
+	 * Oldest report in the ring.
+	 *
+	 * The ring must not be empty.
+	 */
+	std::span<const uint8_t> front () const;
+	/**
+	 * Receive time of the oldest report.
+	 */
+	const Timestamp &frontTimestamp () const;
+	/**
+	 * Remove the oldest report.
+	 */
+	void pop ();
+
+	/**
+	 * Remove all reports.
+	 */
+	void clear ();
+
+private:
+	std::size_t _report_size;
+	std::vector<uint8_t> _data;
+	std::vector<std::size_t> _lengths;
+	std::vector<Timestamp> _timestamps;
+	std::size_t _head, _count;
+};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HID_TIMESTAMP_H
+#define LIBHIDPP_HID_TIMESTAMP_H
+
+#include <chrono>
+
+namespace HID
+{
+
+/**
+ * Time when a report was received.
+ */
+struct Timestamp
+{
+	/**
+	 * Monotonic time (CLOCK_MONOTONIC on Linux).
+	 */
+	std::chrono::steady_clock::time_point monotonic;
+	/**
+	 * Time since the CLOCK_MONOTONIC_RAW epoch, not affected by NTP
+	 * frequency adjustments.
+	 *
+	 * Zero unless enabled with RawDevice::setRawTimestamps (Linux
+	 * backend only).
+	 */
+	std::chrono::nanoseconds monotonic_raw;
+};
+
+}
+
+#endif
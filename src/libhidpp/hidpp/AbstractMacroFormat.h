@@ -31,7 +31,7 @@ namespace HIDPP
 /**
  * Abstract class from macro formats.
  *
- * At least getLength(), writeAddress(), writeItem()
+ * At least getLength(), getMaxLength(), writeAddress(), writeItem()
  * and parseItem() must be implemented by the subclass.
  */
 class AbstractMacroFormat
@@ -59,6 +59,10 @@ public:
 	 * Get the length of the encoded instruction.
 	 */
 	virtual std::size_t getLength (const Macro::Item &item) const = 0;
+	/**
+	 * Get the length of the longest encoded instruction.
+	 */
+	virtual std::size_t getMaxLength () const = 0;
 
 	/**
 	 * Get the length for a jump instruction.
@@ -21,26 +21,110 @@
 #include <misc/Endian.h>
 #include <misc/CRC.h>
 #include <misc/Log.h>
+#include <misc/PersistentCache.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 
 using namespace HIDPP;
 
 AbstractMemoryMapping::AbstractMemoryMapping (bool write_crc):
-	_write_crc (write_crc)
+	_write_crc (write_crc),
+	_cache_modified (false)
+{
+}
+
+AbstractMemoryMapping::~AbstractMemoryMapping ()
+{
+	if (_cache_modified)
+		savePageCache ();
+}
+
+bool AbstractMemoryMapping::enablePageCache ()
 {
+	auto name = pageCacheName ();
+	if (name.empty () || lineSize () == 0)
+		return false;
+	auto path = PersistentCache::path (name);
+	if (path.empty ())
+		return false;
+	_cache_path = path;
+	_cache_identity = pageCacheIdentity ();
+	loadPageCache ();
+	for (const auto &[address, page]: _pages)
+		if (page.read_lines.empty () && !page.modified)
+			cachePage (address, page.data);
+	return true;
 }
 
 const std::vector<uint8_t> &AbstractMemoryMapping::getReadOnlyPage (const Address &address)
 {
-	return getPage (address).data;
+	return getPage (address, 0, std::numeric_limits<std::size_t>::max ()).data;
 }
 
 std::vector<uint8_t> &AbstractMemoryMapping::getWritablePage (const Address &address)
 {
-	auto &page = getPage (address);
-	page.modified = true;
+	auto &page = getPage (address, 0, std::numeric_limits<std::size_t>::max ());
+	if (!page.modified) {
+		page.original = page.data;
+		page.modified = true;
+	}
 	return page.data;
 }
 
+std::vector<uint8_t>::const_iterator AbstractMemoryMapping::getReadOnlyIterator (const Address &address, std::size_t length)
+{
+	auto offset = byteOffset (address);
+	return getPartialPage (address, offset, offset + length).begin () + offset;
+}
+
+void AbstractMemoryMapping::readRange (const Address &address, std::vector<uint8_t>::const_iterator it, std::size_t length)
+{
+	auto &page = getPage (address, 0, 0);
+	auto offset = std::distance (page.data.cbegin (), it);
+	readPageRange (address, page, offset, offset + length);
+}
+
+const std::vector<uint8_t> &AbstractMemoryMapping::getPartialPage (const Address &address, std::size_t begin, std::size_t end)
+{
+	return getPage (address, begin, end).data;
+}
+
+std::size_t AbstractMemoryMapping::lineSize () const
+{
+	return 0;
+}
+
+std::size_t AbstractMemoryMapping::pageSize (const Address &) const
+{
+	throw std::logic_error ("pageSize is not implemented");
+}
+
+std::size_t AbstractMemoryMapping::byteOffset (const Address &address) const
+{
+	return address.offset;
+}
+
+void AbstractMemoryMapping::readLines (const Address &, std::size_t, std::size_t, std::vector<uint8_t> &)
+{
+	throw std::logic_error ("readLines is not implemented");
+}
+
+std::string AbstractMemoryMapping::pageCacheName () const
+{
+	return {};
+}
+
+std::string AbstractMemoryMapping::pageCacheIdentity () const
+{
+	return {};
+}
+
 void AbstractMemoryMapping::sync ()
 {
 	for (auto &p: _pages) {
@@ -52,20 +136,204 @@ void AbstractMemoryMapping::sync ()
 							   page.data.end () - sizeof (crc));
 				writeBE (page.data.end () - sizeof (crc), crc);
 			}
-			writePage (address, page.data);
+			auto diff = std::mismatch (page.data.begin (), page.data.end (),
+						   page.original.begin (), page.original.end ());
+			if (diff.first == page.data.end ()) {
+				Log::debug ("memory").printf ("Page %d:%u is unchanged\n",
+							      address.mem_type, address.page);
+			}
+			else {
+				auto last = std::mismatch (page.data.rbegin (), page.data.rend (),
+							   page.original.rbegin (), page.original.rend ());
+				std::size_t begin = std::distance (page.data.begin (), diff.first);
+				std::size_t end = std::distance (last.first, page.data.rend ());
+				Log::debug ("memory").printf ("Writing bytes %zu to %zu of page %d:%u\n",
+							      begin, end, address.mem_type, address.page);
+				writeRange (address, page.data, begin, end);
+				if (!_cache_path.empty ())
+					cachePage (address, page.data);
+			}
+			page.original.clear ();
 			page.modified = false;
 		}
 	}
 }
 
-AbstractMemoryMapping::Page &AbstractMemoryMapping::getPage (Address address)
+void AbstractMemoryMapping::writeRange (const Address &address, const std::vector<uint8_t> &data, std::size_t, std::size_t)
+{
+	writePage (address, data);
+}
+
+AbstractMemoryMapping::Page &AbstractMemoryMapping::getPage (Address address, std::size_t begin, std::size_t end)
 {
 	address.offset = 0;
 	auto it = _pages.find (address);
 	if (it == _pages.end ()) {
 		it = _pages.emplace (address, Page { false }).first;
-		readPage (address, it->second.data);
+		auto &page = it->second;
+		if (auto line_size = lineSize ()) {
+			page.data.resize (pageSize (address));
+			page.read_lines.resize ((page.data.size () + line_size - 1) / line_size, false);
+			if (!_cache_path.empty () && !useCachedPage (address, page)) {
+				// Read the whole page so that it can be cached.
+				readPageRange (address, page, 0, page.data.size ());
+				cachePage (address, page.data);
+			}
+		}
+		else
+			readPage (address, page.data);
 	}
+	readPageRange (address, it->second, begin, end);
 	return it->second;
 }
 
+void AbstractMemoryMapping::readPageRange (const Address &address, Page &page, std::size_t begin, std::size_t end)
+{
+	if (page.read_lines.empty ())
+		return;
+	auto line_size = lineSize ();
+	end = std::min (end, page.data.size ());
+	if (begin >= end)
+		return;
+	// Read each run of consecutive unread lines at once.
+	std::size_t line = begin / line_size, last = (end + line_size - 1) / line_size;
+	while (line < last) {
+		if (page.read_lines[line]) {
+			++line;
+			continue;
+		}
+		auto run_end = line;
+		while (run_end < last && !page.read_lines[run_end])
+			++run_end;
+		Log::debug ("memory").printf ("Reading lines %zu to %zu of page %d:%u\n",
+					      line, run_end, address.mem_type, address.page);
+		readLines (address, line * line_size,
+			   std::min (run_end * line_size, page.data.size ()),
+			   page.data);
+		std::fill (page.read_lines.begin () + line, page.read_lines.begin () + run_end, true);
+		line = run_end;
+	}
+	if (std::all_of (page.read_lines.begin (), page.read_lines.end (), [] (bool read) { return read; }))
+		page.read_lines.clear ();
+}
+
+/*
+ * Page cache files contain a header identifying the device followed by
+ * one line per page:
+ *
+ *     hidpp-pages 1
+ *     <identity>
+ *     <memory type> <page> <bytes>
+ *
+ * Bytes are written as a single hexadecimal string.
+ */
+static constexpr const char *PageCacheHeader = "hidpp-pages 1";
+
+static bool hasValidCRC (const std::vector<uint8_t> &data)
+{
+	if (data.size () <= sizeof (uint16_t))
+		return false;
+	auto crc = CRC::CCITT (std::span (data).first (data.size () - sizeof (uint16_t)));
+	return crc == readBE<uint16_t> (data.end () - sizeof (uint16_t));
+}
+
+static bool parseBytes (const std::string &str, std::vector<uint8_t> &data)
+{
+	if (str.size () % 2 != 0)
+		return false;
+	data.resize (str.size () / 2);
+	for (std::size_t i = 0; i < data.size (); ++i) {
+		auto first = str.data () + 2*i, last = first + 2;
+		auto [ptr, ec] = std::from_chars (first, last, data[i], 16);
+		if (ec != std::errc () || ptr != last)
+			return false;
+	}
+	return true;
+}
+
+void AbstractMemoryMapping::loadPageCache ()
+{
+	std::ifstream file (_cache_path);
+	if (!file)
+		return;
+	std::string header, identity;
+	std::getline (file, header);
+	std::getline (file, identity);
+	if (header != PageCacheHeader || identity != _cache_identity) {
+		Log::debug ("memory") << "Ignoring page cache for another device." << std::endl;
+		return;
+	}
+	std::map<Address, std::vector<uint8_t>> pages;
+	int mem_type;
+	unsigned int page;
+	std::string bytes;
+	while (file >> mem_type >> page >> bytes) {
+		std::vector<uint8_t> data;
+		if (!parseBytes (bytes, data) || !hasValidCRC (data)) {
+			Log::warning ("memory").printf ("Invalid page cache %s\n", _cache_path.c_str ());
+			return;
+		}
+		pages.emplace (Address { mem_type, page, 0 }, std::move (data));
+	}
+	if (!file.eof ()) {
+		Log::warning ("memory").printf ("Invalid page cache %s\n", _cache_path.c_str ());
+		return;
+	}
+	_cached_pages = std::move (pages);
+	Log::debug ("memory").printf ("Loaded %zu page images from %s\n",
+				      _cached_pages.size (), _cache_path.c_str ());
+}
+
+void AbstractMemoryMapping::savePageCache ()
+{
+	std::ostringstream out;
+	out << PageCacheHeader << "\n";
+	out << _cache_identity << "\n";
+	out << std::hex << std::setfill ('0');
+	for (const auto &[address, data]: _cached_pages) {
+		out << std::dec << address.mem_type << " " << address.page << " " << std::hex;
+		for (uint8_t byte: data)
+			out << std::setw (2) << unsigned (byte);
+		out << "\n";
+	}
+	if (PersistentCache::write (_cache_path, out.str ()))
+		_cache_modified = false;
+}
+
+bool AbstractMemoryMapping::useCachedPage (const Address &address, Page &page)
+{
+	auto it = _cached_pages.find (address);
+	if (it == _cached_pages.end () || it->second.size () != page.data.size ())
+		return false;
+	// The last line contains the CRC of the page.
+	auto line_size = lineSize ();
+	std::size_t last_line = (page.data.size () - 1) / line_size * line_size;
+	readPageRange (address, page, last_line, page.data.size ());
+	if (!std::equal (page.data.begin () + last_line, page.data.end (),
+			 it->second.begin () + last_line)) {
+		Log::debug ("memory").printf ("Cached page %d:%u is outdated\n",
+					      address.mem_type, address.page);
+		return false;
+	}
+	Log::debug ("memory").printf ("Using cached page %d:%u\n",
+				      address.mem_type, address.page);
+	page.data = it->second;
+	page.read_lines.clear ();
+	return true;
+}
+
+void AbstractMemoryMapping::cachePage (const Address &address, const std::vector<uint8_t> &data)
+{
+	auto it = _cached_pages.find (address);
+	if (!hasValidCRC (data)) {
+		if (it != _cached_pages.end ()) {
+			_cached_pages.erase (it);
+			_cache_modified = true;
+		}
+		return;
+	}
+	if (it != _cached_pages.end () && it->second == data)
+		return;
+	_cached_pages[address] = data;
+	_cache_modified = true;
+}
@@ -22,6 +22,8 @@
 #include <hidpp/Address.h>
 #include <vector>
 #include <map>
+#include <string>
+#include <cstddef>
 #include <cstdint>
 
 namespace HIDPP
@@ -34,11 +36,36 @@ namespace HIDPP
  * for memory access, and getReadOnlyIterator,
  * getWritableIterator and computeOffset to convert
  * between address offsets and iterators.
+ *
+ * Subclasses that can read parts of a page also implement lineSize,
+ * pageSize, byteOffset and readLines. Pages are then read lazily, line
+ * by line, when a range is asked with getReadOnlyIterator(const Address &,
+ * std::size_t) or readRange. Pages are read entirely before being
+ * modified.
+ *
+ * Page images can also be kept between program runs (see enablePageCache).
  */
 class AbstractMemoryMapping
 {
 public:
 	AbstractMemoryMapping (bool write_crc = true);
+	virtual ~AbstractMemoryMapping ();
+
+	/**
+	 * Keep page images in the persistent cache (see PersistentCache).
+	 *
+	 * A cached image is used instead of reading the page when the last
+	 * line of the page, containing its CRC, is the same on the device.
+	 * Only pages with a valid CRC are cached. Pages that are not cached
+	 * are read entirely so that they can be saved, the cache file is
+	 * written when this object is destroyed.
+	 *
+	 * The page cache needs lineSize and pageCacheName to be implemented.
+	 *
+	 * \returns false if the page cache is not supported or persistent
+	 * caches are disabled.
+	 */
+	bool enablePageCache ();
 
 	/**
 	 * Get the page at \p address (offset is ignored) as read-only.
@@ -49,8 +76,28 @@ public:
 	 */
 	std::vector<uint8_t> &getWritablePage (const Address &address);
 
+	/**
+	 * Get a read-only iterator to the position corresponding to the
+	 * address \p address.
+	 *
+	 * Only the \p length bytes following the position (or until the
+	 * end of the page) are guaranteed to be read, the rest of the page
+	 * may not be.
+	 */
+	std::vector<uint8_t>::const_iterator getReadOnlyIterator (const Address &address, std::size_t length);
+
+	/**
+	 * Make sure the \p length bytes from \p it are read, \p it is an
+	 * iterator in the page at \p address (offset is ignored).
+	 */
+	void readRange (const Address &address, std::vector<uint8_t>::const_iterator it, std::size_t length);
+
 	/**
 	 * Write all modified pages to the device memory.
+	 *
+	 * Pages are compared with the image read from the device (after
+	 * updating their CRC), unchanged pages are not written and only the
+	 * changed part of the others is given to writeRange.
 	 */
 	void sync ();
 
@@ -87,16 +134,80 @@ protected:
 	 * Write the data in \p data in page at \p address.
 	 */
 	virtual void writePage (const Address &address, const std::vector<uint8_t> &data) = 0;
+	/**
+	 * Write the bytes from \p begin to \p end of \p data in page at
+	 * \p address, the rest of the page is unchanged.
+	 *
+	 * The default implementation writes the whole page with writePage.
+	 */
+	virtual void writeRange (const Address &address, const std::vector<uint8_t> &data, std::size_t begin, std::size_t end);
+
+	/**
+	 * Size in bytes of the parts that readLines can read, 0 if pages can
+	 * only be read entirely with readPage (the default).
+	 */
+	virtual std::size_t lineSize () const;
+	/**
+	 * Size in bytes of the page at \p address, only used when lineSize is not 0.
+	 */
+	virtual std::size_t pageSize (const Address &address) const;
+	/**
+	 * Position in bytes of \p address in its page.
+	 */
+	virtual std::size_t byteOffset (const Address &address) const;
+	/**
+	 * Read bytes from \p begin to \p end of the page at \p address into
+	 * the same positions of \p data, which is as large as the page.
+	 *
+	 * \p begin is a multiple of lineSize, \p end also is unless it is the
+	 * end of the page.
+	 */
+	virtual void readLines (const Address &address, std::size_t begin, std::size_t end, std::vector<uint8_t> &data);
+
+	/**
+	 * Name of the page cache file, empty if the page cache is not
+	 * supported (the default).
+	 */
+	virtual std::string pageCacheName () const;
+	/**
+	 * Line identifying the device in the page cache file, images
+	 * cached for another identity are ignored.
+	 */
+	virtual std::string pageCacheIdentity () const;
+
+	/**
+	 * Get the page at \p address (offset is ignored) with only the bytes
+	 * from \p begin to \p end guaranteed to be read.
+	 */
+	const std::vector<uint8_t> &getPartialPage (const Address &address, std::size_t begin, std::size_t end);
 
 private:
 	bool _write_crc;
 	struct Page {
 		bool modified;
 		std::vector<uint8_t> data;
+		std::vector<bool> read_lines; // empty when the whole page is read
+		std::vector<uint8_t> original; // device content, set when the page becomes writable
 	};
 	std::map<Address, Page> _pages;
+	std::string _cache_path, _cache_identity; // empty when the page cache is disabled
+	std::map<Address, std::vector<uint8_t>> _cached_pages;
+	bool _cache_modified;
 
-	Page &getPage (Address address);
+	Page &getPage (Address address, std::size_t begin, std::size_t end);
+	void readPageRange (const Address &address, Page &page, std::size_t begin, std::size_t end);
+
+	void loadPageCache ();
+	void savePageCache ();
+	/**
+	 * Check the last line of the page and fill \p page with the cached
+	 * image if it is up to date.
+	 */
+	bool useCachedPage (const Address &address, Page &page);
+	/**
+	 * Update the cached image of the page at \p address.
+	 */
+	void cachePage (const Address &address, const std::vector<uint8_t> &data);
 };
 
 }
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP_COMMAND_TABLE_H
+#define LIBHIDPP_HIDPP_COMMAND_TABLE_H
+
+#include <hidpp/defs.h>
+
+#include <array>
+#include <optional>
+#include <stdexcept>
+
+namespace HIDPP
+{
+
+/**
+ * Fixed-capacity table of pending commands.
+ *
+ * Commands are indexed by their matching key: device index, sub ID (or
+ * feature index) and address (or function and software ID). Inserting,
+ * matching and removing a command are constant time operations and never
+ * allocate memory.
+ *
+ * Several commands may share the same key, they are then matched in the
+ * order they were inserted.
+ *
+ * \tparam T		Command type
+ * \tparam Capacity	Maximum number of pending commands (at most 255)
+ */
+template<typename T, std::size_t Capacity>
+class CommandTable
+{
+	static_assert (Capacity > 0 && Capacity < 0xff);
+	static constexpr std::size_t IndexBits = [] () {
+		std::size_t bits = 0;
+		while ((std::size_t (1) << bits) < 2*Capacity)
+			++bits;
+		return bits;
+	} ();
+	static constexpr std::size_t IndexSize = std::size_t (1) << IndexBits;
+	static constexpr uint8_t Empty = 0xff;
+
+public:
+	/**
+	 * Identifies an inserted command, stays valid (but does not match
+	 * anything) after the command is removed.
+	 */
+	struct Handle
+	{
+		uint8_t slot;
+		uint32_t seq;
+	};
+
+	/**
+	 * Exception thrown when inserting in a full table.
+	 */
+	class Full: public std::exception
+	{
+	public:
+		const char *what () const noexcept
+		{
+			return "Too many pending commands";
+		}
+	};
+
+	static constexpr uint32_t key (DeviceIndex index, uint8_t sub_id, uint8_t address) noexcept
+	{
+		return uint32_t (index) << 16 | uint32_t (sub_id) << 8 | address;
+	}
+
+	CommandTable ():
+		_next_seq (0),
+		_free_count (Capacity)
+	{
+		_index.fill (Empty);
+		for (std::size_t i = 0; i < Capacity; ++i)
+			_free[i] = Capacity-1-i;
+	}
+
+	bool empty () const noexcept
+	{
+		return _free_count == Capacity;
+	}
+
+	bool full () const noexcept
+	{
+		return _free_count == 0;
+	}
+
+	/**
+	 * Insert a new command.
+	 *
+	 * \throws Full
+	 */
+	Handle insert (uint32_t key, T &&value)
+	{
+		if (_free_count == 0)
+			throw Full ();
+		uint8_t slot = _free[--_free_count];
+		auto &s = _slots[slot];
+		s.key = key;
+		s.seq = _next_seq++;
+		s.value.emplace (std::move (value));
+		auto pos = home (key);
+		while (_index[pos] != Empty)
+			pos = (pos+1) % IndexSize;
+		_index[pos] = slot;
+		return Handle { slot, s.seq };
+	}
+
+	/**
+	 * Remove and return the oldest command matching \p key.
+	 */
+	std::optional<T> take (uint32_t key)
+	{
+		std::size_t found = IndexSize;
+		for (auto pos = home (key); _index[pos] != Empty; pos = (pos+1) % IndexSize) {
+			const auto &s = _slots[_index[pos]];
+			if (s.key == key && (found == IndexSize || seqBefore (s.seq, _slots[_index[found]].seq)))
+				found = pos;
+		}
+		if (found == IndexSize)
+			return std::nullopt;
+		return remove (found);
+	}
+
+	/**
+	 * Remove and return the command identified by \p handle if it
+	 * is still present.
+	 */
+	std::optional<T> take (Handle handle)
+	{
+		const auto &s = _slots[handle.slot];
+		if (!s.value || s.seq != handle.seq)
+			return std::nullopt;
+		for (auto pos = home (s.key); _index[pos] != Empty; pos = (pos+1) % IndexSize) {
+			if (_index[pos] == handle.slot)
+				return remove (pos);
+		}
+		return std::nullopt;
+	}
+
+	/**
+	 * Remove the commands for which \p pred returns true and give
+	 * them to \p f.
+	 */
+	template<typename Pred, typename F>
+	void takeIf (Pred pred, F f)
+	{
+		for (std::size_t slot = 0; slot < Capacity; ++slot) {
+			auto &s = _slots[slot];
+			if (s.value && pred (*s.value))
+				if (auto value = take (Handle { uint8_t (slot), s.seq }))
+					f (std::move (*value));
+		}
+	}
+
+	/**
+	 * Call \p f on every pending command.
+	 */
+	template<typename F>
+	void forEach (F f)
+	{
+		for (auto &s: _slots)
+			if (s.value)
+				f (*s.value);
+	}
+
+	/**
+	 * Remove every pending command.
+	 */
+	void clear ()
+	{
+		_index.fill (Empty);
+		_free_count = 0;
+		for (std::size_t i = 0; i < Capacity; ++i) {
+			_slots[i].value.reset ();
+			_free[_free_count++] = i;
+		}
+	}
+
+private:
+	struct Slot
+	{
+		uint32_t key;
+		uint32_t seq;
+		std::optional<T> value;
+	};
+	std::array<Slot, Capacity> _slots;
+	std::array<uint8_t, IndexSize> _index;
+	std::array<uint8_t, Capacity> _free;
+	uint32_t _next_seq;
+	std::size_t _free_count;
+
+	static constexpr std::size_t home (uint32_t key) noexcept
+	{
+		return (key * 0x9e3779b1u) >> (32 - IndexBits);
+	}
+
+	static constexpr bool seqBefore (uint32_t a, uint32_t b) noexcept
+	{
+		return int32_t (a - b) < 0;
+	}
+
+	std::optional<T> remove (std::size_t pos)
+	{
+		uint8_t slot = _index[pos];
+		std::optional<T> value (std::move (_slots[slot].value));
+		_slots[slot].value.reset ();
+		_free[_free_count++] = slot;
+		// Backward shift deletion: move following entries of the probe
+		// sequence that can fill the hole.
+		auto hole = pos;
+		for (auto next = (pos+1) % IndexSize; _index[next] != Empty; next = (next+1) % IndexSize) {
+			auto h = home (_slots[_index[next]].key);
+			if ((next - h) % IndexSize >= (next - hole) % IndexSize) {
+				_index[hole] = _index[next];
+				hole = next;
+			}
+		}
+		_index[hole] = Empty;
+		return value;
+	}
+};
+
+}
+
+#endif
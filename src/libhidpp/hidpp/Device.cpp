@@ -20,13 +20,15 @@
 
 #include <hidpp/Dispatcher.h>
 #include <hidpp10/Device.h>
-#include <hidpp10/IReceiver.h>
+#include <hidpp10/PairingCache.h>
 #include <hidpp10/Error.h>
+#include <hidpp20/Error.h>
 #include <hidpp20/IRoot.h>
 #include <misc/Log.h>
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 
 using namespace HIDPP;
 
@@ -50,22 +52,14 @@ Device::Device (Dispatcher *dispatcher, DeviceIndex device_index):
 	bool is_wireless = device_index >= WirelessDevice1 && device_index <= WirelessDevice6;
 	if (is_wireless) {
 		// Ask receiver for device info when wireless
-		HIDPP10::Device ur (_dispatcher, DefaultDevice);
-		HIDPP10::IReceiver ireceiver (&ur);
 		try {
-			ireceiver.getDeviceInformation (device_index - 1,
-							nullptr,
-							nullptr,
-							&_product_id,
-							nullptr);
-			_name = ireceiver.getDeviceName (device_index - 1);
+			auto info = _dispatcher->pairingCache ().get (device_index);
+			_product_id = info.wpid;
+			_name = std::move (info.name);
 		}
 		catch (HIDPP10::Error &e) {
-			if (e.errorCode () == HIDPP10::Error::InvalidValue) {
-				// the invalid value is the device index
-				throw HIDPP10::Error (HIDPP10::Error::UnknownDevice);
-			}
-			Log::error () << "Error while asking receiver for infos: " << e.what () << std::endl;
+			if (e.errorCode () != HIDPP10::Error::UnknownDevice)
+				Log::error () << "Error while asking receiver for infos: " << e.what () << std::endl;
 			throw;
 		}
 	}
@@ -76,15 +70,9 @@ Device::Device (Dispatcher *dispatcher, DeviceIndex device_index):
 	}
 
 	// Check protocol version
-	static constexpr unsigned int software_id = 1;
-	auto type = _dispatcher->reportInfo ().findReport ();
-	assert (type);
-	Report request (*type, _device_index, HIDPP20::IRoot::index, HIDPP20::IRoot::Ping, software_id);
-	auto response = _dispatcher->sendCommand (std::move (request));
+	auto response = _dispatcher->sendCommand (makePing (_dispatcher, _device_index));
 	try {
-		auto report = response->get (is_wireless ? 2000 : 500); // use longer timeout for wireless devices that can be sleeping.
-		auto params = report.parameterBegin ();
-		_version = std::make_tuple (params[0], params[1]);
+		_version = pingVersion (response->get (_dispatcher->commandTimeout (_device_index)));
 	}
 	catch (HIDPP10::Error &e) {
 		// Valid HID++1.0 devices should send a "Invalid SubID" error.
@@ -94,6 +82,28 @@ Device::Device (Dispatcher *dispatcher, DeviceIndex device_index):
 	}
 }
 
+Device::Device (Dispatcher *dispatcher, DeviceIndex device_index,
+		uint16_t product_id, std::string name,
+		std::tuple<unsigned int, unsigned int> version):
+	_dispatcher (dispatcher), _device_index (device_index),
+	_product_id (product_id), _name (std::move (name)), _version (version)
+{
+}
+
+Report Device::makePing (Dispatcher *dispatcher, DeviceIndex device_index)
+{
+	static constexpr unsigned int software_id = 1;
+	auto type = dispatcher->reportInfo ().findReport ();
+	assert (type);
+	return Report (*type, device_index, HIDPP20::IRoot::index, HIDPP20::IRoot::Ping, software_id);
+}
+
+std::tuple<unsigned int, unsigned int> Device::pingVersion (const Report &response)
+{
+	auto params = response.parameterBegin ();
+	return std::make_tuple (params[0], params[1]);
+}
+
 Dispatcher *Device::dispatcher () const
 {
 	return _dispatcher;
@@ -118,3 +128,88 @@ std::tuple<unsigned int, unsigned int> Device::protocolVersion ()
 {
 	return _version;
 }
+
+std::vector<Device> HIDPP::discoverDevices (Dispatcher *dispatcher)
+{
+	static constexpr DeviceIndex indices[] = {
+		DefaultDevice,
+		CordedDevice,
+		WirelessDevice1,
+		WirelessDevice2,
+		WirelessDevice3,
+		WirelessDevice4,
+		WirelessDevice5,
+		WirelessDevice6,
+	};
+	// All the pings share a single deadline taken from the first send,
+	// with the longest timeout of the probed indices.
+	int timeout = 0;
+	for (auto index: indices)
+		timeout = std::max (timeout, dispatcher->commandTimeout (index));
+	auto deadline = std::chrono::steady_clock::now () + std::chrono::milliseconds (timeout);
+	std::vector<std::unique_ptr<Dispatcher::AsyncReport>> pings;
+	for (auto index: indices)
+		pings.push_back (dispatcher->sendCommand (Device::makePing (dispatcher, index)));
+
+	std::vector<Device> devices;
+	bool has_receiver = false;
+	for (unsigned int i = 0; i < pings.size (); ++i) {
+		DeviceIndex index = indices[i];
+		bool is_wireless = index >= WirelessDevice1 && index <= WirelessDevice6;
+		// Wireless indices only make sense behind a receiver. Destroying
+		// an unanswered ping cancels it, the remaining pings are
+		// cancelled when the pings vector is destroyed.
+		if (is_wireless && !has_receiver)
+			break;
+		try {
+			uint16_t product_id;
+			std::string name;
+			if (is_wireless) {
+				try {
+					auto info = dispatcher->pairingCache ().get (index);
+					product_id = info.wpid;
+					name = std::move (info.name);
+				}
+				catch (HIDPP10::Error &e) {
+					if (e.errorCode () == HIDPP10::Error::UnknownDevice) {
+						// nothing is paired with this index
+						pings[i].reset ();
+						continue;
+					}
+					throw;
+				}
+			}
+			else {
+				product_id = dispatcher->productID ();
+				name = dispatcher->name ();
+			}
+
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds> (
+				deadline - std::chrono::steady_clock::now ());
+			std::tuple<unsigned int, unsigned int> version;
+			try {
+				version = Device::pingVersion (pings[i]->get (std::max<int> (0, remaining.count ())));
+			}
+			catch (HIDPP10::Error &e) {
+				if (e.errorCode () != HIDPP10::Error::InvalidSubID)
+					throw;
+				version = std::make_tuple (1, 0);
+			}
+			devices.push_back (Device (dispatcher, index, product_id, std::move (name), version));
+			if (index == DefaultDevice && version == std::make_tuple (1, 0))
+				has_receiver = true;
+		}
+		catch (HIDPP10::Error &e) {
+			if (e.errorCode () != HIDPP10::Error::UnknownDevice && e.errorCode () != HIDPP10::Error::InvalidSubID)
+				Log::warning ("discovery").printf ("Error while probing device %d: %s\n", index, e.what ());
+		}
+		catch (HIDPP20::Error &e) {
+			if (e.errorCode () != HIDPP20::Error::UnknownDevice)
+				Log::warning ("discovery").printf ("Error while probing device %d: %s\n", index, e.what ());
+		}
+		catch (Dispatcher::TimeoutError &e) {
+			Log::warning ("discovery").printf ("Device %d timed out\n", index);
+		}
+	}
+	return devices;
+}
@@ -23,6 +23,7 @@
 #include <hidpp/Report.h>
 #include <string>
 #include <tuple>
+#include <vector>
 
 namespace HIDPP
 {
@@ -95,6 +96,24 @@ public:
 	std::tuple<unsigned int, unsigned int> protocolVersion ();
 
 private:
+	/**
+	 * Build a device from already known information (see discoverDevices).
+	 */
+	Device (Dispatcher *dispatcher, DeviceIndex device_index,
+		uint16_t product_id, std::string name,
+		std::tuple<unsigned int, unsigned int> version);
+
+	/**
+	 * Build the IRoot Ping request used for checking the protocol version.
+	 */
+	static Report makePing (Dispatcher *dispatcher, DeviceIndex device_index);
+	/**
+	 * Read the protocol version from a Ping response.
+	 */
+	static std::tuple<unsigned int, unsigned int> pingVersion (const Report &response);
+
+	friend std::vector<Device> discoverDevices (Dispatcher *dispatcher);
+
 	Dispatcher *_dispatcher;
 	DeviceIndex _device_index;
 	uint16_t _product_id;
@@ -102,6 +121,23 @@ private:
 	std::tuple<unsigned int, unsigned int> _version;
 };
 
+/**
+ * Find every device using \p dispatcher.
+ *
+ * Pings for the default, corded and all wireless device indices are sent at
+ * once. While they are in flight, the pairing information of the wireless
+ * indices is read from the receiver (if the default index is a HID++1.0
+ * receiver) through Dispatcher::pairingCache. Answers are then collected as
+ * they arrive, so the whole discovery takes at most one command timeout
+ * (see Dispatcher::commandTimeout) instead of one per index.
+ *
+ * Unpaired indices and devices that do not speak HID++ are skipped, other
+ * errors and timeouts are logged and the device is skipped.
+ *
+ * \returns the devices that answered, in device index order.
+ */
+std::vector<Device> discoverDevices (Dispatcher *dispatcher);
+
 }
 
 #endif
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DeviceSession.h"
+
+#include <hidpp10/defs.h>
+#include <misc/Log.h>
+
+using namespace HIDPP;
+
+struct DeviceSession::Node
+{
+	DispatcherThread dispatcher;
+	std::atomic<bool> running;
+	std::thread thread;
+
+	Node (const std::string &path):
+		dispatcher (path.c_str ()),
+		running (true),
+		thread ([this] () {
+			dispatcher.run ();
+			running = false;
+		})
+	{
+	}
+
+	~Node ()
+	{
+		dispatcher.stop ();
+		thread.join ();
+	}
+};
+
+DeviceSession::DeviceSession (DeviceSessionManager *manager, const std::string &path, DeviceIndex index):
+	_manager (manager),
+	_path (path),
+	_index (index),
+	_stale (std::make_shared<std::atomic<bool>> (true))
+{
+}
+
+DeviceSession::~DeviceSession ()
+{
+	unwatch ();
+}
+
+const std::string &DeviceSession::path () const
+{
+	return _path;
+}
+
+DeviceIndex DeviceSession::deviceIndex () const
+{
+	return _index;
+}
+
+HIDPP::Device &DeviceSession::device ()
+{
+	if (!_device || _stale->load () || !_node->running)
+		bind ();
+	return *_device;
+}
+
+HIDPP20::Device &DeviceSession::device20 ()
+{
+	auto &dev = device ();
+	if (!_device20)
+		throw HIDPP::Device::InvalidProtocolVersion (dev.protocolVersion ());
+	return *_device20;
+}
+
+void DeviceSession::invalidate ()
+{
+	_stale->store (true);
+}
+
+void DeviceSession::bind ()
+{
+	// Clear the flag first: a notification received while binding
+	// will trigger another binding.
+	_stale->store (false);
+	try {
+		auto node = _manager->node (_path);
+		if (node != _node) {
+			unwatch ();
+			_node = node;
+			watch (node);
+		}
+		HIDPP::Device dev (&_node->dispatcher, _index);
+		bool same = _device &&
+			_device->productID () == dev.productID () &&
+			_device->name () == dev.name () &&
+			_device->protocolVersion () == dev.protocolVersion ();
+		if (_device20 && same) {
+			// Keep the feature indices, only update the dispatcher.
+			static_cast<HIDPP::Device &> (*_device20) = dev;
+		}
+		else {
+			_device20.reset ();
+			if (std::get<0> (dev.protocolVersion ()) >= 2)
+				_device20.emplace (HIDPP::Device (dev));
+		}
+		Log::debug ("session").printf ("%s session for %s (device %d): %s\n",
+				same ? "Rebound" : "Bound", _path.c_str (), _index, dev.name ().c_str ());
+		_device = std::move (dev);
+	}
+	catch (...) {
+		_stale->store (true);
+		throw;
+	}
+}
+
+void DeviceSession::watch (const std::shared_ptr<Node> &node)
+{
+	if (_index < WirelessDevice1 || _index > WirelessDevice6)
+		return;
+	for (uint8_t sub_id: { HIDPP10::DeviceDisconnection, HIDPP10::DeviceConnection })
+		_listeners.push_back (node->dispatcher.registerEventHandler (_index, sub_id,
+			[stale = _stale] (const Report &) {
+				stale->store (true);
+				return true;
+			}));
+}
+
+void DeviceSession::unwatch ()
+{
+	if (_node)
+		for (auto it: _listeners)
+			_node->dispatcher.unregisterEventHandler (it);
+	_listeners.clear ();
+}
+
+DeviceSessionManager::DeviceSessionManager ()
+{
+}
+
+DeviceSessionManager::~DeviceSessionManager ()
+{
+}
+
+std::shared_ptr<DeviceSession> DeviceSessionManager::open (const std::string &path, DeviceIndex index)
+{
+	auto key = std::make_pair (path, index);
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		auto it = _sessions.find (key);
+		if (it != _sessions.end ())
+			if (auto session = it->second.lock ())
+				return session;
+	}
+	// Bind without the lock, it waits for the device.
+	std::shared_ptr<DeviceSession> session (new DeviceSession (this, path, index));
+	session->bind ();
+	std::unique_lock<std::mutex> lock (_mutex);
+	auto &weak = _sessions[key];
+	if (auto other = weak.lock ())
+		return other; // opened concurrently
+	weak = session;
+	return session;
+}
+
+void DeviceSessionManager::deviceAdded (const std::string &path)
+{
+	closeNode (path);
+}
+
+void DeviceSessionManager::deviceRemoved (const std::string &path)
+{
+	closeNode (path);
+}
+
+std::shared_ptr<DeviceSession::Node> DeviceSessionManager::node (const std::string &path)
+{
+	std::unique_lock<std::mutex> lock (_mutex);
+	auto &node = _nodes[path];
+	if (!node || !node->running) {
+		try {
+			node = std::make_shared<DeviceSession::Node> (path);
+		}
+		catch (...) {
+			_nodes.erase (path);
+			throw;
+		}
+	}
+	return node;
+}
+
+void DeviceSessionManager::closeNode (const std::string &path)
+{
+	std::unique_lock<std::mutex> lock (_mutex);
+	auto node = _nodes.find (path);
+	if (node != _nodes.end ()) {
+		// The thread is joined when the last session releases the node.
+		node->second->dispatcher.stop ();
+		_nodes.erase (node);
+	}
+	for (auto it = _sessions.begin (); it != _sessions.end (); ) {
+		auto session = it->second.lock ();
+		if (!session)
+			it = _sessions.erase (it);
+		else {
+			if (session->_path == path)
+				session->invalidate ();
+			++it;
+		}
+	}
+}
+
+DeviceSessionMonitor::DeviceSessionMonitor (DeviceSessionManager *manager):
+	_manager (manager)
+{
+}
+
+void DeviceSessionMonitor::addDevice (const char *path)
+{
+	_manager->deviceAdded (path);
+}
+
+void DeviceSessionMonitor::removeDevice (const char *path)
+{
+	_manager->deviceRemoved (path);
+}
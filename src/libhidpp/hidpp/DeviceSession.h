@@ -0,0 +1,171 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP_DEVICE_SESSION_H
+#define LIBHIDPP_HIDPP_DEVICE_SESSION_H
+
+#include <hid/DeviceMonitor.h>
+#include <hidpp/Device.h>
+#include <hidpp/DispatcherThread.h>
+#include <hidpp20/Device.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace HIDPP
+{
+
+class DeviceSessionManager;
+
+/**
+ * Device kept open between operations (see DeviceSessionManager).
+ *
+ * The session checks its binding each time the device is accessed. It is
+ * bound again when the receiver reports that the wireless device
+ * (dis)connected or when the HID node was removed. If the device is the
+ * same (same product ID, name and protocol version), the existing
+ * HIDPP20::Device and its feature indices are kept and only pointed at
+ * the new dispatcher.
+ *
+ * A session must only be used by one thread at a time.
+ */
+class DeviceSession
+{
+public:
+	~DeviceSession ();
+
+	const std::string &path () const;
+	DeviceIndex deviceIndex () const;
+
+	/**
+	 * Get the device, binding the session again if needed.
+	 *
+	 * \throws the errors of the HIDPP::Device constructor if the device
+	 * cannot be reached.
+	 */
+	HIDPP::Device &device ();
+
+	/**
+	 * Get the HID++2.0 device, binding the session again if needed.
+	 *
+	 * \throws HIDPP::Device::InvalidProtocolVersion for HID++1.0 devices.
+	 */
+	HIDPP20::Device &device20 ();
+
+	/**
+	 * Force the next access to check the device again.
+	 */
+	void invalidate ();
+
+private:
+	struct Node;
+
+	DeviceSession (DeviceSessionManager *manager, const std::string &path, DeviceIndex index);
+
+	void bind ();
+	void watch (const std::shared_ptr<Node> &node);
+	void unwatch ();
+
+	DeviceSessionManager *_manager;
+	std::string _path;
+	DeviceIndex _index;
+	std::shared_ptr<Node> _node;
+	std::vector<Dispatcher::listener_iterator> _listeners;
+	// shared with the event handlers, that may outlive the session
+	std::shared_ptr<std::atomic<bool>> _stale;
+	std::optional<HIDPP::Device> _device;
+	std::optional<HIDPP20::Device> _device20;
+
+	friend DeviceSessionManager;
+};
+
+/**
+ * Keeps HID nodes, dispatchers and devices open for long-lived processes.
+ *
+ * Each HID node is opened once and driven by a DispatcherThread with its
+ * own thread. Protocol versions, names, receiver pairing information and
+ * feature indices are kept in the sessions, so that repeated operations
+ * only cost their own round trips.
+ *
+ * Hotplug events are given to deviceAdded and deviceRemoved, for example
+ * from a DeviceSessionMonitor.
+ *
+ * This class is thread-safe. Sessions must not be used after their
+ * manager is destroyed.
+ */
+class DeviceSessionManager
+{
+public:
+	DeviceSessionManager ();
+	~DeviceSessionManager ();
+
+	/**
+	 * Get the session for device \p index of the HID node \p path.
+	 *
+	 * The same session is returned as long as it is referenced. A new
+	 * session is bound immediately.
+	 */
+	std::shared_ptr<DeviceSession> open (const std::string &path, DeviceIndex index = DefaultDevice);
+
+	/**
+	 * Sessions on \p path will be bound again (the node may have been
+	 * replaced by another device).
+	 */
+	void deviceAdded (const std::string &path);
+
+	/**
+	 * Close the HID node \p path, its sessions will reopen it when used.
+	 */
+	void deviceRemoved (const std::string &path);
+
+private:
+	std::shared_ptr<DeviceSession::Node> node (const std::string &path);
+	void closeNode (const std::string &path);
+
+	std::mutex _mutex;
+	std::map<std::string, std::shared_ptr<DeviceSession::Node>> _nodes;
+	std::map<std::pair<std::string, DeviceIndex>, std::weak_ptr<DeviceSession>> _sessions;
+
+	friend DeviceSession;
+};
+
+/**
+ * Forwards the hotplug events of a HID::DeviceMonitor to a
+ * DeviceSessionManager.
+ */
+class DeviceSessionMonitor: public HID::DeviceMonitor
+{
+public:
+	DeviceSessionMonitor (DeviceSessionManager *manager);
+
+protected:
+	void addDevice (const char *path);
+	void removeDevice (const char *path);
+
+private:
+	DeviceSessionManager *_manager;
+};
+
+}
+
+#endif
@@ -18,10 +18,17 @@
 
 #include "Dispatcher.h"
 
+#include <hidpp10/PairingCache.h>
 #include <misc/Log.h>
 
+#include <algorithm>
+
 using namespace HIDPP;
 
+// Number of processEvent calls running in this thread, unregistering from
+// an event handler must not wait for the handlers to return.
+static thread_local unsigned int processing_events = 0;
+
 const char *Dispatcher::NoHIDPPReportException::what () const noexcept
 {
 	return "No HID++ report";
@@ -36,29 +43,346 @@ Dispatcher::AsyncReport::~AsyncReport ()
 {
 }
 
+Dispatcher::Dispatcher ()
+{
+}
+
 Dispatcher::~Dispatcher ()
 {
+	// The cache unregisters its listeners, destroy it before them.
+	_pairing_cache.reset ();
+	for (auto &row: _listeners) {
+		if (auto r = row.load ()) {
+			for (auto &list: *r)
+				delete list.load ();
+			delete r;
+		}
+	}
+	for (auto list: _retired_listeners)
+		delete list;
 }
 
 Dispatcher::listener_iterator Dispatcher::registerEventHandler (DeviceIndex index, uint8_t sub_id, const event_handler &handler)
 {
-	return _listeners.emplace (std::make_tuple (index, sub_id), handler);
+	std::unique_lock<std::mutex> lock (_listener_write_mutex);
+	auto row = _listeners[index].load ();
+	if (!row) {
+		row = new listener_row ();
+		_listeners[index].store (row);
+	}
+	auto &slot = (*row)[sub_id];
+	auto old = slot.load ();
+	auto list = old ? new listener_list (*old) : new listener_list ();
+	unsigned int id = ++_next_listener_id;
+	list->push_back ({ id, handler });
+	replaceListeners (slot, list);
+	return { index, sub_id, id };
 }
 
 void Dispatcher::unregisterEventHandler (listener_iterator it)
 {
-	_listeners.erase (it);
+	if (!removeListener (it))
+		return;
+	// Wait for the events using the old list to be processed, so the
+	// handler is not running anymore when this returns. The write mutex
+	// is not held: handlers may register or unregister listeners.
+	if (processing_events == 0)
+		waitForListenerReaders ();
+}
+
+bool Dispatcher::removeListener (listener_iterator it)
+{
+	std::unique_lock<std::mutex> lock (_listener_write_mutex);
+	auto row = _listeners[it.index].load ();
+	if (!row)
+		return false;
+	auto &slot = (*row)[it.sub_id];
+	auto old = slot.load ();
+	if (!old)
+		return false;
+	auto listener = std::find_if (old->begin (), old->end (), [&it] (const Listener &l) {
+		return l.id == it.id;
+	});
+	if (listener == old->end ())
+		return false;
+	listener_list *list = nullptr;
+	if (old->size () > 1) {
+		list = new listener_list ();
+		list->reserve (old->size () - 1);
+		for (const auto &l: *old)
+			if (l.id != it.id)
+				list->push_back (l);
+	}
+	replaceListeners (slot, list);
+	return true;
+}
+
+void Dispatcher::replaceListeners (std::atomic<const listener_list *> &slot, const listener_list *list)
+{
+	auto old = slot.exchange (list);
+	if (old)
+		_retired_listeners.push_back (old);
+	// Events processed from now on will use the new list, the old
+	// lists can be deleted if no event is being processed.
+	if (_listener_readers[0].load () == 0 && _listener_readers[1].load () == 0) {
+		for (auto l: _retired_listeners)
+			delete l;
+		_retired_listeners.clear ();
+	}
+}
+
+void Dispatcher::waitForListenerReaders ()
+{
+	std::unique_lock<std::mutex> lock (_listener_grace_mutex);
+	// New events count themselves with the other parity after each
+	// flip, only the events older than the flip are waited for. Flip
+	// twice so both counters were drained once since this call.
+	for (int i = 0; i < 2; ++i) {
+		auto &readers = _listener_readers[_listener_epoch.fetch_add (1) & 1];
+		unsigned int count;
+		while ((count = readers.load ()) != 0)
+			readers.wait (count);
+	}
+}
+
+int Dispatcher::commandTimeout (DeviceIndex index) const noexcept
+{
+	using std::chrono::milliseconds;
+	bool is_wireless = index >= WirelessDevice1 && index <= WirelessDevice6;
+	auto timeout = _metrics.roundTripEstimator (index).timeout (
+		milliseconds (is_wireless ? WirelessInitialTimeout : CordedInitialTimeout),
+		milliseconds (is_wireless ? WirelessMinimumTimeout : CordedMinimumTimeout),
+		milliseconds (MaximumTimeout));
+	return std::chrono::ceil<milliseconds> (timeout).count ();
+}
+
+HIDPP10::PairingCache &Dispatcher::pairingCache ()
+{
+	std::unique_lock<std::mutex> lock (_pairing_cache_mutex);
+	if (!_pairing_cache)
+		_pairing_cache = std::make_unique<HIDPP10::PairingCache> (this);
+	return *_pairing_cache;
 }
 
 void Dispatcher::processEvent (const Report &report)
 {
-	auto range = _listeners.equal_range (std::make_tuple (report.deviceIndex (), report.subID ()));
-	for (auto it = range.first; it != range.second;) {
-		if (it->second (report))
-			++it;
-		else
-			it = _listeners.erase (it);
+	std::vector<unsigned int> expired;
+	{
+		struct ReaderGuard {
+			std::atomic<unsigned int> &readers;
+			ReaderGuard (std::atomic<unsigned int> &readers): readers (readers) {
+				++processing_events;
+				++readers;
+			}
+			~ReaderGuard () {
+				if (--readers == 0)
+					readers.notify_all ();
+				--processing_events;
+			}
+		} guard (_listener_readers[_listener_epoch.load () & 1]);
+		auto row = _listeners[report.deviceIndex ()].load ();
+		auto list = row ? (*row)[report.subID ()].load () : nullptr;
+		if (!list)
+			return;
+		_metrics.increment (DispatcherMetrics::EventsDelivered);
+		for (const auto &listener: *list)
+			if (!listener.handler (report))
+				expired.push_back (listener.id);
+	}
+	// Expired handlers have already returned.
+	for (auto id: expired)
+		removeListener ({ report.deviceIndex (), report.subID (), id });
+}
+
+void Dispatcher::sendCommand (Report &&report, report_handler &&handler, int timeout)
+{
+	std::optional<Report> response;
+	try {
+		auto command = sendCommand (std::move (report));
+		response.emplace (timeout < 0 ? command->get () : command->get (timeout));
+	}
+	catch (...) {
+		handler (nullptr, std::current_exception ());
+		return;
+	}
+	handler (&*response, nullptr);
+}
+
+Dispatcher::query_key Dispatcher::queryKey (const Report &report)
+{
+	auto params = report.parameters ();
+	query_key key;
+	key.reserve (4 + params.size ());
+	key.push_back (report.deviceIndex ());
+	key.push_back (report.subID ());
+	key.push_back (report.address () & 0xf0); // ignore the software ID
+	key.push_back (report.type ());
+	key.insert (key.end (), params.begin (), params.end ());
+	return key;
+}
+
+void Dispatcher::sendQuery (Report &&report, report_handler &&handler, std::chrono::milliseconds max_age)
+{
+	auto key = queryKey (report);
+	{
+		std::unique_lock<std::mutex> lock (_query_mutex);
+		if (max_age > std::chrono::milliseconds::zero ()) {
+			auto it = _query_answers.find (key);
+			if (it != _query_answers.end () &&
+			    it->second.generation == queryGeneration (key) &&
+			    std::chrono::steady_clock::now () - it->second.received <= max_age) {
+				Report answer = it->second.report;
+				lock.unlock ();
+				_metrics.increment (DispatcherMetrics::QueryCacheHits);
+				handler (&answer, nullptr);
+				return;
+			}
+		}
+		// An event or invalidateQueries changing the generation after
+		// this point prevents the answer from being kept.
+		auto generation = queryGeneration (key).load ();
+		auto [it, inserted] = _pending_queries.try_emplace (key, PendingQuery { {}, max_age, generation });
+		it->second.handlers.push_back (std::move (handler));
+		it->second.max_age = std::max (it->second.max_age, max_age);
+		if (!inserted) {
+			_metrics.increment (DispatcherMetrics::QueriesCoalesced);
+			return;
+		}
+	}
+	try {
+		sendCommand (std::move (report), [this, key] (const Report *report, std::exception_ptr error) {
+			completeQuery (key, report, error);
+		});
+	}
+	catch (...) {
+		completeQuery (key, nullptr, std::current_exception ());
+	}
+}
+
+std::atomic<unsigned int> &Dispatcher::queryGeneration (DeviceIndex index, uint8_t sub_id)
+{
+	// Features sharing a counter only discard each other's answers.
+	return _query_generations[(index * 37u + sub_id) % _query_generations.size ()];
+}
+
+std::atomic<unsigned int> &Dispatcher::queryGeneration (const query_key &key)
+{
+	return queryGeneration (static_cast<DeviceIndex> (key[0]), key[1]);
+}
+
+void Dispatcher::completeQuery (const query_key &key, const Report *report, std::exception_ptr error)
+{
+	std::vector<report_handler> handlers;
+	{
+		std::unique_lock<std::mutex> lock (_query_mutex);
+		auto it = _pending_queries.find (key);
+		handlers = std::move (it->second.handlers);
+		auto max_age = it->second.max_age;
+		auto generation = it->second.generation;
+		if (report && generation == queryGeneration (key) &&
+		    max_age > std::chrono::milliseconds::zero ()) {
+			auto now = std::chrono::steady_clock::now ();
+			std::erase_if (_query_answers, [now] (const auto &answer) {
+				return answer.second.expires < now;
+			});
+			_query_answers.insert_or_assign (key, QueryAnswer { *report, now, now + max_age, generation });
+		}
+		_pending_queries.erase (it);
+	}
+	for (auto &handler: handlers)
+		handler (report, error);
+}
+
+void Dispatcher::invalidateQueries (DeviceIndex index, uint8_t sub_id)
+{
+	++queryGeneration (index, sub_id);
+}
+
+void Dispatcher::getNotification (DeviceIndex index, uint8_t sub_id, report_handler &&handler, int timeout)
+{
+	std::optional<Report> notification;
+	try {
+		auto async = getNotification (index, sub_id);
+		notification.emplace (timeout < 0 ? async->get () : async->get (timeout));
 	}
+	catch (...) {
+		handler (nullptr, std::current_exception ());
+		return;
+	}
+	handler (&*notification, nullptr);
+}
+
+Dispatcher::ReportAwaiter Dispatcher::command (Report &&report)
+{
+	int timeout = commandTimeout (report.deviceIndex ());
+	return ReportAwaiter (this, std::move (report), timeout);
+}
+
+Dispatcher::ReportAwaiter Dispatcher::command (Report &&report, int timeout)
+{
+	return ReportAwaiter (this, std::move (report), timeout);
+}
+
+Dispatcher::ReportAwaiter Dispatcher::notification (DeviceIndex index, uint8_t sub_id, int timeout)
+{
+	return ReportAwaiter (this, index, sub_id, timeout);
+}
+
+Dispatcher::ReportAwaiter::ReportAwaiter (Dispatcher *dispatcher, Report &&request, int timeout):
+	_dispatcher (dispatcher),
+	_request (std::move (request)),
+	_timeout (timeout),
+	_state (Waiting)
+{
+}
+
+Dispatcher::ReportAwaiter::ReportAwaiter (Dispatcher *dispatcher, DeviceIndex index, uint8_t sub_id, int timeout):
+	_dispatcher (dispatcher),
+	_index (index),
+	_sub_id (sub_id),
+	_timeout (timeout),
+	_state (Waiting)
+{
+}
+
+bool Dispatcher::ReportAwaiter::await_suspend (std::coroutine_handle<> handle)
+{
+	_handle = handle;
+	auto handler = [this] (const Report *report, std::exception_ptr error) {
+		complete (report, error);
+	};
+	if (_request)
+		_dispatcher->sendCommand (std::move (*_request), handler, _timeout);
+	else
+		_dispatcher->getNotification (_index, _sub_id, handler, _timeout);
+	// The handler may already have been called (synchronously or
+	// from another thread), do not suspend in that case.
+	return _state.exchange (Suspended) != Done;
+}
+
+Report Dispatcher::ReportAwaiter::await_resume ()
+{
+	if (_error)
+		std::rethrow_exception (_error);
+	return *_report;
+}
+
+void Dispatcher::ReportAwaiter::complete (const Report *report, std::exception_ptr error)
+{
+	if (report)
+		_report.emplace (*report);
+	else
+		_error = error;
+	if (_state.exchange (Done) == Suspended)
+		_handle.resume ();
+}
+
+unsigned int Dispatcher::nextSoftwareID (DeviceIndex index, uint8_t feature_index)
+{
+	std::unique_lock<std::mutex> lock (_software_id_mutex);
+	auto &sw_id = _software_ids[std::make_tuple (index, feature_index)];
+	sw_id = sw_id % SoftwareIDCount + 1;
+	return sw_id;
 }
 
 static bool hasReport(const HID::ReportCollection &collection, HID::ReportID::Type type, uint8_t id, HID::Usage usage, unsigned int count)
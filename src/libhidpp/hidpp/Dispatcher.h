@@ -20,10 +20,20 @@
 #define LIBHIDPP_HIDPP_DISPATCHER_H
 
 #include <hidpp/Report.h>
+#include <hidpp/DispatcherMetrics.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
 #include <memory>
 #include <map>
 #include <functional>
 #include <optional>
+#include <mutex>
+#include <vector>
+
+namespace HIDPP10 { class PairingCache; }
 
 namespace HIDPP
 {
@@ -32,8 +42,17 @@ class Dispatcher
 {
 public:
 	typedef std::function<bool (const Report &)> event_handler;
-	typedef std::multimap<std::tuple<DeviceIndex, uint8_t>, event_handler> listener_container;
-	typedef listener_container::iterator listener_iterator;
+
+	/**
+	 * Identifies a registered event handler.
+	 */
+	struct listener_handle
+	{
+		DeviceIndex index;
+		uint8_t sub_id;
+		unsigned int id;
+	};
+	typedef listener_handle listener_iterator;
 
 	/**
 	 * Exception when no HID++ report is found in the report descriptor.
@@ -52,6 +71,13 @@ public:
 	class AsyncReport
 	{
 	public:
+		/**
+		 * Destroying the object before the report is received
+		 * cancels the command or notification.
+		 *
+		 * An AsyncReport that was not answered must not outlive
+		 * its dispatcher, answered ones may.
+		 */
 		virtual ~AsyncReport ();
 
 		/**
@@ -78,6 +104,7 @@ public:
 		virtual Report get (int timeout) = 0;
 	};
 
+	Dispatcher ();
 	virtual ~Dispatcher ();
 
 	virtual uint16_t vendorID () const = 0;
@@ -104,19 +131,115 @@ public:
 	 */
 	virtual std::unique_ptr<AsyncReport> getNotification (DeviceIndex index, uint8_t sub_id) = 0;
 
+	/**
+	 * Callback receiving an answer or a notification.
+	 *
+	 * Exactly one of \p report and \p error is set. \p report is only
+	 * valid during the call. The callback must not throw.
+	 */
+	typedef std::function<void (const Report *report, std::exception_ptr error)> report_handler;
+
+	/**
+	 * Sends the report and calls \p handler with the matching answer.
+	 *
+	 * The default implementation waits for the answer and calls
+	 * \p handler before returning. Asynchronous dispatchers call
+	 * \p handler later from the thread dispatching reports, without
+	 * holding any of their locks.
+	 *
+	 * If no answer is received after \p timeout milliseconds, \p handler
+	 * is given a TimeoutError and the command is forgotten. There is
+	 * no timeout if \p timeout is negative.
+	 */
+	virtual void sendCommand (Report &&report, report_handler &&handler, int timeout = -1);
+
+	/**
+	 * Calls \p handler with exactly one notification matching
+	 * \p index and \p sub_id.
+	 *
+	 * \sa sendCommand(Report &&, report_handler &&, int)
+	 */
+	virtual void getNotification (DeviceIndex index, uint8_t sub_id, report_handler &&handler, int timeout = -1);
+
+	/**
+	 * Sends a read-only HID++2.0 request and calls \p handler with the
+	 * matching answer.
+	 *
+	 * If an identical query (same device index, feature index, function,
+	 * report type and parameters, the software ID is ignored) is already
+	 * in flight, nothing is sent and \p handler is given the answer of
+	 * the first query. It must only be used for requests without side
+	 * effects.
+	 *
+	 * If \p max_age is not zero, the answer of a query completed at most
+	 * \p max_age ago may be used instead of sending the request, and the
+	 * answer of this query is kept for \p max_age. Kept answers of a
+	 * feature are discarded by invalidateQueries and by any event from
+	 * this feature.
+	 *
+	 * \sa sendCommand(Report &&, report_handler &&)
+	 */
+	void sendQuery (Report &&report, report_handler &&handler,
+			std::chrono::milliseconds max_age = std::chrono::milliseconds::zero ());
+
+	/**
+	 * Discard the kept query answers for feature \p sub_id of device
+	 * \p index, answers of the queries in flight will not be kept either.
+	 *
+	 * Call it before sending a request that may change these answers.
+	 * Dispatchers call it for every event. This method is thread-safe
+	 * and does not take any lock.
+	 */
+	void invalidateQueries (DeviceIndex index, uint8_t sub_id);
+
+	class ReportAwaiter;
+
+	/**
+	 * Awaitable version of sendCommand.
+	 *
+	 * \code
+	 * Report response = co_await dispatcher->command (std::move (request));
+	 * \endcode
+	 *
+	 * The awaiting coroutine is resumed from the thread dispatching
+	 * reports and must not be destroyed while it is waiting.
+	 *
+	 * co_await throws TimeoutError if no answer is received after
+	 * \p timeout milliseconds (commandTimeout for the device index of
+	 * \p report when it is not given).
+	 */
+	ReportAwaiter command (Report &&report);
+	ReportAwaiter command (Report &&report, int timeout);
+
+	/**
+	 * Awaitable version of getNotification.
+	 *
+	 * \sa command
+	 */
+	ReportAwaiter notification (DeviceIndex index, uint8_t sub_id, int timeout = -1);
+
 	/**
 	 * Add a listener function for events matching \p index and \p sub_id.
 	 *
+	 * The handler is removed when it returns false.
+	 *
+	 * Registering and unregistering is thread-safe and may be done
+	 * from an event handler.
+	 *
 	 * \param index		Event device index
 	 * \param sub_id	Event sub_id (or feature index)
 	 * \param handler	Callback for handling the event
 	 *
-	 * \returns The listener iterator used for unregistering.
+	 * \returns The listener handle used for unregistering.
 	 */
 	virtual listener_iterator registerEventHandler (DeviceIndex index, uint8_t sub_id, const event_handler &handler);
 
 	/**
-	 * Unregister the event handler given by the iterator.
+	 * Unregister the event handler given by the handle.
+	 *
+	 * When called outside of an event handler, it waits for the events
+	 * being processed to finish: the handler is not running anymore
+	 * when it returns and its captured state can be destroyed.
 	 */
 	virtual void unregisterEventHandler (listener_iterator it);
 
@@ -146,13 +269,188 @@ public:
 	};
 	ReportInfo reportInfo () const noexcept { return _report_info; }
 
+	/**
+	 * Number of software IDs used by nextSoftwareID, it is also the maximum
+	 * number of requests to the same feature that can be in flight.
+	 */
+	static constexpr unsigned int SoftwareIDCount = 15;
+
+	/**
+	 * Get a software ID for a new HID++2.0 request.
+	 *
+	 * Software IDs rotate from 1 to SoftwareIDCount independently for
+	 * each device index and feature index, so up to SoftwareIDCount
+	 * requests to the same feature can be told apart while they are in
+	 * flight.
+	 *
+	 * This method is thread-safe.
+	 */
+	unsigned int nextSoftwareID (DeviceIndex index, uint8_t feature_index);
+
+	/**
+	 * Performance counters and round-trip times of this dispatcher.
+	 */
+	const DispatcherMetrics &metrics () const noexcept { return _metrics; }
+
+	/**
+	 * Timeouts in milliseconds for commands to devices without any
+	 * round-trip time sample yet. Wireless devices may be sleeping and
+	 * take longer to answer.
+	 */
+	static constexpr int CordedInitialTimeout = 500;
+	static constexpr int WirelessInitialTimeout = 2000;
+	/**
+	 * Bounds in milliseconds of the adaptive timeouts.
+	 */
+	static constexpr int CordedMinimumTimeout = 100;
+	static constexpr int WirelessMinimumTimeout = 500;
+	static constexpr int MaximumTimeout = 16000;
+
+	/**
+	 * Get a timeout in milliseconds for a command to device \p index.
+	 *
+	 * It is derived from the round-trip times of the previous commands
+	 * to the same index (see RoundTripEstimator): lost answers are
+	 * detected quickly on fast links and the timeout is longer where
+	 * the link is slow. It is doubled after each command timeout until
+	 * an answer is received.
+	 */
+	int commandTimeout (DeviceIndex index) const noexcept;
+
+	/**
+	 * Pairing information of the receiver using this dispatcher.
+	 *
+	 * The cache is created on first use and lives as long as the
+	 * dispatcher. This method is thread-safe.
+	 */
+	HIDPP10::PairingCache &pairingCache ();
+
 protected:
+	DispatcherMetrics _metrics;
+
+	/**
+	 * Call the event handlers matching \p report.
+	 *
+	 * It does not take any lock and can run concurrently with
+	 * registerEventHandler and unregisterEventHandler.
+	 */
 	void processEvent (const Report &);
+	/**
+	 * Remove the listener without waiting for running handlers, for
+	 * callers holding a lock that the handler may also take.
+	 *
+	 * \returns false if the listener was not registered.
+	 */
+	bool removeListener (listener_iterator it);
 	void checkReportDescriptor (const HID::ReportDescriptor &report_desc);
 
 private:
-	listener_container _listeners;
+	struct Listener
+	{
+		unsigned int id;
+		event_handler handler;
+	};
+	// Listener lists are immutable once published, they are replaced
+	// with a modified copy and the old list is deleted when no
+	// event is being processed.
+	typedef std::vector<Listener> listener_list;
+	typedef std::array<std::atomic<const listener_list *>, 256> listener_row;
+	std::array<std::atomic<listener_row *>, 256> _listeners;
+	// Events being processed, counted by the parity of _listener_epoch
+	// when they started.
+	std::array<std::atomic<unsigned int>, 2> _listener_readers {};
+	std::atomic<unsigned int> _listener_epoch {0};
+	std::mutex _listener_grace_mutex;
+	std::mutex _listener_write_mutex;
+	unsigned int _next_listener_id = 0;
+	std::vector<const listener_list *> _retired_listeners;
+
+	/**
+	 * Publish \p list in \p slot, _listener_write_mutex must be locked.
+	 */
+	void replaceListeners (std::atomic<const listener_list *> &slot, const listener_list *list);
+	/**
+	 * Wait for the events that started processing before this call.
+	 *
+	 * Events starting later are not waited for, so a continuous event
+	 * stream cannot delay it indefinitely.
+	 */
+	void waitForListenerReaders ();
+
 	ReportInfo _report_info;
+	std::mutex _software_id_mutex;
+	std::map<std::tuple<DeviceIndex, uint8_t>, uint8_t> _software_ids;
+	std::mutex _pairing_cache_mutex;
+	std::unique_ptr<HIDPP10::PairingCache> _pairing_cache;
+
+	/**
+	 * Device index, feature index, function, report type and parameters.
+	 */
+	typedef std::vector<uint8_t> query_key;
+	static query_key queryKey (const Report &report);
+	void completeQuery (const query_key &key, const Report *report, std::exception_ptr error);
+
+	/**
+	 * Answers are only kept or used while the generation of their
+	 * feature is the one read when the query was sent.
+	 */
+	struct PendingQuery
+	{
+		std::vector<report_handler> handlers;
+		std::chrono::milliseconds max_age;
+		unsigned int generation;
+	};
+	struct QueryAnswer
+	{
+		Report report;
+		std::chrono::steady_clock::time_point received, expires;
+		unsigned int generation;
+	};
+	std::mutex _query_mutex;
+	std::map<query_key, PendingQuery> _pending_queries;
+	std::map<query_key, QueryAnswer> _query_answers;
+	/**
+	 * Generation counters incremented by invalidateQueries, indexed by a
+	 * hash of the device index and feature index.
+	 */
+	std::array<std::atomic<unsigned int>, 1024> _query_generations {};
+	std::atomic<unsigned int> &queryGeneration (DeviceIndex index, uint8_t sub_id);
+	std::atomic<unsigned int> &queryGeneration (const query_key &key);
+};
+
+/**
+ * Awaiter returned by Dispatcher::command and Dispatcher::notification.
+ */
+class Dispatcher::ReportAwaiter
+{
+public:
+	bool await_ready () const noexcept { return false; }
+	bool await_suspend (std::coroutine_handle<> handle);
+	Report await_resume ();
+
+private:
+	ReportAwaiter (Dispatcher *dispatcher, Report &&request, int timeout);
+	ReportAwaiter (Dispatcher *dispatcher, DeviceIndex index, uint8_t sub_id, int timeout);
+
+	void complete (const Report *report, std::exception_ptr error);
+
+	enum State {
+		Waiting,
+		Suspended,
+		Done,
+	};
+
+	Dispatcher *_dispatcher;
+	std::optional<Report> _request;
+	DeviceIndex _index;
+	uint8_t _sub_id;
+	int _timeout;
+	std::coroutine_handle<> _handle;
+	std::atomic<State> _state;
+	std::optional<Report> _report;
+	std::exception_ptr _error;
+
+	friend Dispatcher;
 };
 
 }
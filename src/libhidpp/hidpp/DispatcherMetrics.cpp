@@ -0,0 +1,270 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DispatcherMetrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+using namespace HIDPP;
+
+LatencyHistogram::LatencyHistogram ():
+	_count (0),
+	_sum (0),
+	_min (std::numeric_limits<uint64_t>::max ()),
+	_max (0)
+{
+	for (auto &bucket: _buckets)
+		bucket.store (0, std::memory_order_relaxed);
+}
+
+unsigned int LatencyHistogram::bucketIndex (uint64_t value) noexcept
+{
+	if (value < SubBucketCount)
+		return value;
+	unsigned int bits = std::bit_width (value);
+	if (bits > MaxValueBits)
+		return BucketCount - 1;
+	unsigned int shift = bits - 1 - SubBucketBits;
+	return (shift + 1) * SubBucketCount + ((value >> shift) & (SubBucketCount - 1));
+}
+
+uint64_t LatencyHistogram::bucketLow (unsigned int index) noexcept
+{
+	unsigned int group = index / SubBucketCount;
+	unsigned int sub = index % SubBucketCount;
+	if (group == 0)
+		return sub;
+	return uint64_t (SubBucketCount + sub) << (group - 1);
+}
+
+uint64_t LatencyHistogram::bucketHigh (unsigned int index) noexcept
+{
+	unsigned int group = index / SubBucketCount;
+	if (group == 0)
+		return index + 1;
+	return bucketLow (index) + (uint64_t (1) << (group - 1));
+}
+
+void LatencyHistogram::record (duration value) noexcept
+{
+	uint64_t v = value.count () < 0 ? 0 : value.count ();
+	_buckets[bucketIndex (v)].fetch_add (1, std::memory_order_relaxed);
+	_count.fetch_add (1, std::memory_order_relaxed);
+	_sum.fetch_add (v, std::memory_order_relaxed);
+	uint64_t current = _min.load (std::memory_order_relaxed);
+	while (v < current && !_min.compare_exchange_weak (current, v, std::memory_order_relaxed));
+	current = _max.load (std::memory_order_relaxed);
+	while (v > current && !_max.compare_exchange_weak (current, v, std::memory_order_relaxed));
+}
+
+uint64_t LatencyHistogram::count () const noexcept
+{
+	return _count.load (std::memory_order_relaxed);
+}
+
+LatencyHistogram::duration LatencyHistogram::min () const noexcept
+{
+	return count () == 0 ? duration::zero () : duration (_min.load (std::memory_order_relaxed));
+}
+
+LatencyHistogram::duration LatencyHistogram::max () const noexcept
+{
+	return duration (_max.load (std::memory_order_relaxed));
+}
+
+LatencyHistogram::duration LatencyHistogram::mean () const noexcept
+{
+	auto n = count ();
+	return n == 0 ? duration::zero () : duration (_sum.load (std::memory_order_relaxed) / n);
+}
+
+LatencyHistogram::duration LatencyHistogram::percentile (double fraction) const noexcept
+{
+	std::array<uint64_t, BucketCount> buckets;
+	uint64_t total = 0;
+	for (unsigned int i = 0; i < BucketCount; ++i)
+		total += buckets[i] = _buckets[i].load (std::memory_order_relaxed);
+	if (total == 0)
+		return duration::zero ();
+	uint64_t rank = std::ceil (std::clamp (fraction, 0.0, 1.0) * total);
+	if (rank == 0)
+		rank = 1;
+	uint64_t cumulated = 0;
+	for (unsigned int i = 0; i < BucketCount; ++i) {
+		cumulated += buckets[i];
+		if (cumulated >= rank)
+			return duration (std::min (bucketHigh (i), _max.load (std::memory_order_relaxed)));
+	}
+	return max ();
+}
+
+void LatencyHistogram::forEachBucket (const std::function<void (duration, duration, uint64_t)> &f) const
+{
+	for (unsigned int i = 0; i < BucketCount; ++i) {
+		auto n = _buckets[i].load (std::memory_order_relaxed);
+		if (n != 0)
+			f (duration (bucketLow (i)), duration (bucketHigh (i)), n);
+	}
+}
+
+RoundTripEstimator::RoundTripEstimator () noexcept:
+	_estimate (0),
+	_back_off (0)
+{
+}
+
+void RoundTripEstimator::addSample (duration rtt) noexcept
+{
+	uint64_t r = std::clamp<int64_t> (rtt.count (), 1, std::numeric_limits<uint32_t>::max ());
+	uint64_t current = _estimate.load (std::memory_order_relaxed);
+	uint64_t next;
+	do {
+		uint64_t srtt = current >> 32, rttvar = current & 0xffffffff;
+		if (current == 0) {
+			srtt = r;
+			rttvar = r / 2;
+		}
+		else {
+			uint64_t delta = srtt > r ? srtt - r : r - srtt;
+			rttvar = (3 * rttvar + delta) / 4;
+			srtt = std::max<uint64_t> ((7 * srtt + r) / 8, 1);
+		}
+		next = srtt << 32 | rttvar;
+	} while (!_estimate.compare_exchange_weak (current, next, std::memory_order_relaxed));
+	_back_off.store (0, std::memory_order_relaxed);
+}
+
+void RoundTripEstimator::backOff () noexcept
+{
+	unsigned int current = _back_off.load (std::memory_order_relaxed);
+	while (current < MaxBackOff && !_back_off.compare_exchange_weak (current, current + 1, std::memory_order_relaxed));
+}
+
+bool RoundTripEstimator::valid () const noexcept
+{
+	return _estimate.load (std::memory_order_relaxed) != 0;
+}
+
+RoundTripEstimator::duration RoundTripEstimator::smoothed () const noexcept
+{
+	return duration (_estimate.load (std::memory_order_relaxed) >> 32);
+}
+
+RoundTripEstimator::duration RoundTripEstimator::variation () const noexcept
+{
+	return duration (_estimate.load (std::memory_order_relaxed) & 0xffffffff);
+}
+
+RoundTripEstimator::duration RoundTripEstimator::timeout (duration initial, duration minimum, duration maximum) const noexcept
+{
+	uint64_t estimate = _estimate.load (std::memory_order_relaxed);
+	duration base = initial;
+	if (estimate != 0) {
+		duration srtt (estimate >> 32), rttvar (estimate & 0xffffffff);
+		base = srtt + std::max (Granularity, 4 * rttvar);
+	}
+	base = std::clamp (base, minimum, maximum);
+	return std::min (base * (1 << _back_off.load (std::memory_order_relaxed)), maximum);
+}
+
+DispatcherMetrics::DispatcherMetrics ()
+{
+	for (auto &counter: _counters)
+		counter.store (0, std::memory_order_relaxed);
+	for (auto &row: _histograms)
+		row.store (nullptr, std::memory_order_relaxed);
+}
+
+DispatcherMetrics::~DispatcherMetrics ()
+{
+	for (auto &row: _histograms) {
+		if (auto r = row.load ()) {
+			for (auto &histogram: *r)
+				delete histogram.load ();
+			delete r;
+		}
+	}
+}
+
+void DispatcherMetrics::recordRoundTripTime (DeviceIndex index, uint8_t sub_id, std::chrono::steady_clock::duration rtt)
+{
+	auto &row_ptr = _histograms[index];
+	auto row = row_ptr.load (std::memory_order_acquire);
+	if (!row) {
+		auto new_row = new histogram_row ();
+		if (row_ptr.compare_exchange_strong (row, new_row, std::memory_order_acq_rel))
+			row = new_row;
+		else
+			delete new_row;
+	}
+	auto &histogram_ptr = (*row)[sub_id];
+	auto histogram = histogram_ptr.load (std::memory_order_acquire);
+	if (!histogram) {
+		auto new_histogram = new LatencyHistogram ();
+		if (histogram_ptr.compare_exchange_strong (histogram, new_histogram, std::memory_order_acq_rel))
+			histogram = new_histogram;
+		else
+			delete new_histogram;
+	}
+	histogram->record (std::chrono::duration_cast<LatencyHistogram::duration> (rtt));
+	_estimators[index].addSample (std::chrono::duration_cast<RoundTripEstimator::duration> (rtt));
+}
+
+void DispatcherMetrics::recordCommandTimeout (DeviceIndex index) noexcept
+{
+	_estimators[index].backOff ();
+}
+
+DispatcherMetrics::Counters DispatcherMetrics::counters () const noexcept
+{
+	auto get = [this] (Counter counter) {
+		return _counters[counter].load (std::memory_order_relaxed);
+	};
+	return Counters {
+		get (CommandsSent),
+		get (ResponsesMatched),
+		get (UnmatchedAnswers),
+		get (HIDPP10Errors),
+		get (HIDPP20Errors),
+		get (Timeouts),
+		get (EventsDelivered),
+		get (QueriesCoalesced),
+		get (QueryCacheHits),
+	};
+}
+
+const LatencyHistogram *DispatcherMetrics::roundTripTime (DeviceIndex index, uint8_t sub_id) const noexcept
+{
+	auto row = _histograms[index].load (std::memory_order_acquire);
+	return row ? (*row)[sub_id].load (std::memory_order_acquire) : nullptr;
+}
+
+void DispatcherMetrics::forEachRoundTripTime (const std::function<void (DeviceIndex, uint8_t, const LatencyHistogram &)> &f) const
+{
+	for (unsigned int index = 0; index < 256; ++index) {
+		auto row = _histograms[index].load (std::memory_order_acquire);
+		if (!row)
+			continue;
+		for (unsigned int sub_id = 0; sub_id < 256; ++sub_id)
+			if (auto histogram = (*row)[sub_id].load (std::memory_order_acquire))
+				f (static_cast<DeviceIndex> (index), sub_id, *histogram);
+	}
+}
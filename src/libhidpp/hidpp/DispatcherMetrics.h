@@ -0,0 +1,240 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP_DISPATCHER_METRICS_H
+#define LIBHIDPP_HIDPP_DISPATCHER_METRICS_H
+
+#include <hidpp/defs.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace HIDPP
+{
+
+/**
+ * Lock-free log-linear histogram of durations.
+ *
+ * Durations are recorded in microseconds. Each power of two is split in
+ * 8 buckets, so recorded values are known with a relative error of at
+ * most 12.5%. Durations longer than about 71 minutes fall in the last
+ * bucket.
+ */
+class LatencyHistogram
+{
+public:
+	typedef std::chrono::microseconds duration;
+
+	static constexpr unsigned int SubBucketBits = 3;
+	static constexpr unsigned int SubBucketCount = 1u << SubBucketBits;
+	static constexpr unsigned int MaxValueBits = 32;
+	static constexpr unsigned int BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+	LatencyHistogram ();
+
+	/**
+	 * Add a value, this is thread-safe and does not take any lock.
+	 */
+	void record (duration value) noexcept;
+
+	uint64_t count () const noexcept;
+	duration min () const noexcept;
+	duration max () const noexcept;
+	duration mean () const noexcept;
+
+	/**
+	 * Get the value below which \p fraction (between 0 and 1) of
+	 * the recorded values fall.
+	 *
+	 * The value is the upper bound of the bucket containing the
+	 * requested rank.
+	 */
+	duration percentile (double fraction) const noexcept;
+
+	/**
+	 * Call \p f for each non-empty bucket with its bounds [low, high)
+	 * and the number of values in it.
+	 */
+	void forEachBucket (const std::function<void (duration low, duration high, uint64_t count)> &f) const;
+
+private:
+	static unsigned int bucketIndex (uint64_t value) noexcept;
+	static uint64_t bucketLow (unsigned int index) noexcept;
+	static uint64_t bucketHigh (unsigned int index) noexcept;
+
+	std::array<std::atomic<uint64_t>, BucketCount> _buckets;
+	std::atomic<uint64_t> _count, _sum, _min, _max;
+};
+
+/**
+ * Smoothed round-trip time and its variation, estimated as TCP does
+ * (RFC 6298).
+ *
+ * The estimate is updated by each sample without any lock. Timeouts
+ * derived from it are doubled by each backOff until a new sample is added.
+ */
+class RoundTripEstimator
+{
+public:
+	typedef std::chrono::microseconds duration;
+
+	/**
+	 * Lower bound of the variation term of the timeout, it covers the
+	 * scheduling delays of the threads reading reports.
+	 */
+	static constexpr duration Granularity = std::chrono::milliseconds (10);
+	/**
+	 * Maximum number of doublings applied by backOff.
+	 */
+	static constexpr unsigned int MaxBackOff = 6;
+
+	RoundTripEstimator () noexcept;
+
+	/**
+	 * Update the estimate with \p rtt and reset the back-off.
+	 */
+	void addSample (duration rtt) noexcept;
+
+	/**
+	 * Double the next timeouts, called when a command timed out.
+	 */
+	void backOff () noexcept;
+
+	/**
+	 * Check if any sample was added.
+	 */
+	bool valid () const noexcept;
+	duration smoothed () const noexcept;
+	duration variation () const noexcept;
+
+	/**
+	 * Get the timeout for the next command.
+	 *
+	 * The timeout is SRTT + max (Granularity, 4·RTTVAR), or \p initial
+	 * if there is no sample yet, clamped to [\p minimum, \p maximum]
+	 * and then doubled for each back-off up to \p maximum.
+	 */
+	duration timeout (duration initial, duration minimum, duration maximum) const noexcept;
+
+private:
+	// SRTT (high 32 bits) and RTTVAR (low 32 bits) in µs, 0 without sample
+	std::atomic<uint64_t> _estimate;
+	std::atomic<unsigned int> _back_off;
+};
+
+/**
+ * Performance counters and round-trip time histograms of a dispatcher.
+ *
+ * Counters use relaxed atomic increments and histograms are only
+ * allocated for the (device index, sub ID) pairs that are actually used,
+ * metrics are always enabled.
+ */
+class DispatcherMetrics
+{
+public:
+	enum Counter {
+		CommandsSent,		///< Reports written to the device
+		ResponsesMatched,	///< Answers given to a pending command
+		UnmatchedAnswers,	///< Answers and errors not matching any command
+		HIDPP10Errors,		///< HID++1.0 error messages received
+		HIDPP20Errors,		///< HID++2.0 error messages received
+		Timeouts,		///< Commands or notifications that timed out
+		EventsDelivered,	///< Events given to at least one handler
+		QueriesCoalesced,	///< Queries attached to an identical query in flight
+		QueryCacheHits,		///< Queries answered from cached results
+		CounterCount
+	};
+
+	/**
+	 * Snapshot of the counters.
+	 */
+	struct Counters
+	{
+		uint64_t commands_sent;
+		uint64_t responses_matched;
+		uint64_t unmatched_answers;
+		uint64_t hidpp10_errors;
+		uint64_t hidpp20_errors;
+		uint64_t timeouts;
+		uint64_t events_delivered;
+		uint64_t queries_coalesced;
+		uint64_t query_cache_hits;
+	};
+
+	DispatcherMetrics ();
+	~DispatcherMetrics ();
+
+	DispatcherMetrics (const DispatcherMetrics &) = delete;
+	DispatcherMetrics &operator= (const DispatcherMetrics &) = delete;
+
+	void increment (Counter counter) noexcept
+	{
+		_counters[counter].fetch_add (1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Record the round-trip time of a command answered by the device
+	 * (with a response or an error).
+	 *
+	 * \param index		Device index of the command
+	 * \param sub_id	HID++1.0 sub ID or HID++2.0 feature index of the command
+	 * \param rtt		Time between writing the command and reading the answer
+	 */
+	void recordRoundTripTime (DeviceIndex index, uint8_t sub_id, std::chrono::steady_clock::duration rtt);
+
+	/**
+	 * Record that a command to \p index timed out.
+	 *
+	 * \sa RoundTripEstimator::backOff
+	 */
+	void recordCommandTimeout (DeviceIndex index) noexcept;
+
+	Counters counters () const noexcept;
+
+	/**
+	 * Get the round-trip time histogram for commands with \p index and
+	 * \p sub_id, or nullptr if no such command was answered.
+	 */
+	const LatencyHistogram *roundTripTime (DeviceIndex index, uint8_t sub_id) const noexcept;
+
+	/**
+	 * Call \p f for each existing round-trip time histogram.
+	 */
+	void forEachRoundTripTime (const std::function<void (DeviceIndex index, uint8_t sub_id, const LatencyHistogram &)> &f) const;
+
+	/**
+	 * Get the round-trip time estimate of all commands to \p index.
+	 */
+	const RoundTripEstimator &roundTripEstimator (DeviceIndex index) const noexcept
+	{
+		return _estimators[index];
+	}
+
+private:
+	std::array<std::atomic<uint64_t>, CounterCount> _counters;
+
+	typedef std::array<std::atomic<LatencyHistogram *>, 256> histogram_row;
+	std::array<std::atomic<histogram_row *>, 256> _histograms;
+	std::array<RoundTripEstimator, 256> _estimators;
+};
+
+}
+
+#endif
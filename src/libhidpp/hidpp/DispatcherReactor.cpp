@@ -0,0 +1,207 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DispatcherReactor.h"
+
+#include <misc/Log.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+}
+
+using namespace HIDPP;
+
+// Bytes written to the pipe.
+enum : char {
+	StopReactor = 0,
+	WakeUpReactor = 1,
+};
+
+DispatcherReactor::DispatcherReactor ()
+{
+	_epoll = ::epoll_create1 (EPOLL_CLOEXEC);
+	if (_epoll == -1)
+		throw std::system_error (errno, std::system_category (), "epoll_create1");
+
+	if (-1 == ::pipe2 (_pipe, O_CLOEXEC)) {
+		int err = errno;
+		::close (_epoll);
+		throw std::system_error (err, std::system_category (), "pipe");
+	}
+
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = _pipe[0];
+	if (-1 == ::epoll_ctl (_epoll, EPOLL_CTL_ADD, _pipe[0], &ev)) {
+		int err = errno;
+		::close (_epoll);
+		::close (_pipe[0]);
+		::close (_pipe[1]);
+		throw std::system_error (err, std::system_category (), "epoll_ctl");
+	}
+}
+
+DispatcherReactor::~DispatcherReactor ()
+{
+	for (auto &p: _devices)
+		p.second->finish (std::make_exception_ptr (DispatcherThread::NotRunning ()));
+	::close (_epoll);
+	::close (_pipe[0]);
+	::close (_pipe[1]);
+}
+
+std::shared_ptr<DispatcherThread> DispatcherReactor::addDevice (const char *path)
+{
+	auto dispatcher = std::make_shared<DispatcherThread> (path);
+	dispatcher->_wake_up = [this] () {
+		char c = WakeUpReactor;
+		if (-1 == ::write (_pipe[1], &c, sizeof (char)))
+			throw std::system_error (errno, std::system_category (), "write pipe");
+	};
+	int fd = dispatcher->_dev.fileDescriptor ();
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		_devices.emplace (fd, dispatcher);
+	}
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (-1 == ::epoll_ctl (_epoll, EPOLL_CTL_ADD, fd, &ev)) {
+		int err = errno;
+		std::unique_lock<std::mutex> lock (_mutex);
+		_devices.erase (fd);
+		throw std::system_error (err, std::system_category (), "epoll_ctl");
+	}
+	Log::debug ("dispatcher").printf ("Added %s to reactor\n", path);
+	return dispatcher;
+}
+
+void DispatcherReactor::removeDevice (const DispatcherThread *dispatcher)
+{
+	int fd = dispatcher->_dev.fileDescriptor ();
+	std::shared_ptr<DispatcherThread> removed;
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		auto it = _devices.find (fd);
+		if (it == _devices.end () || it->second.get () != dispatcher)
+			return;
+		removed = takeDevice (fd);
+	}
+	removed->finish (std::make_exception_ptr (DispatcherThread::NotRunning ()));
+}
+
+void DispatcherReactor::run ()
+{
+	static constexpr std::size_t MaxEvents = 16;
+	std::array<struct epoll_event, MaxEvents> events;
+	bool stopped = false;
+	while (!stopped) {
+		int count = ::epoll_wait (_epoll, events.data (), events.size (), expireRequests ());
+		if (count == -1) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error (errno, std::system_category (), "epoll_wait");
+		}
+		for (int i = 0; i < count; ++i) {
+			int fd = events[i].data.fd;
+			if (fd == _pipe[0]) {
+				char c;
+				if (-1 == ::read (_pipe[0], &c, sizeof (char)))
+					throw std::system_error (errno, std::system_category (), "read pipe");
+				if (c == StopReactor)
+					stopped = true;
+				continue;
+			}
+			std::shared_ptr<DispatcherThread> dispatcher;
+			{
+				std::unique_lock<std::mutex> lock (_mutex);
+				auto it = _devices.find (fd);
+				if (it == _devices.end ())
+					continue; // the device was removed after epoll_wait returned
+				dispatcher = it->second;
+			}
+			try {
+				dispatcher->receiveReport (0);
+			}
+			catch (std::exception &e) {
+				Log::error () << "Failed to read HID report: " << e.what () << std::endl;
+				{
+					std::unique_lock<std::mutex> lock (_mutex);
+					auto it = _devices.find (fd);
+					if (it != _devices.end () && it->second == dispatcher)
+						takeDevice (fd);
+				}
+				dispatcher->finish (std::current_exception ());
+			}
+		}
+	}
+	decltype (_devices) devices;
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		for (const auto &p: _devices)
+			::epoll_ctl (_epoll, EPOLL_CTL_DEL, p.first, nullptr);
+		std::swap (devices, _devices);
+	}
+	for (auto &p: devices)
+		p.second->finish (std::make_exception_ptr (DispatcherThread::NotRunning ()));
+}
+
+int DispatcherReactor::expireRequests ()
+{
+	std::vector<std::shared_ptr<DispatcherThread>> devices;
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		devices.reserve (_devices.size ());
+		for (const auto &p: _devices)
+			devices.push_back (p.second);
+	}
+	auto next = DispatcherThread::time_point::max ();
+	for (const auto &dispatcher: devices)
+		next = std::min (next, dispatcher->expireRequests ());
+	for (const auto &dispatcher: devices)
+		dispatcher->setWaitDeadline (next);
+	if (next == DispatcherThread::time_point::max ())
+		return -1;
+	auto remaining = std::chrono::ceil<std::chrono::milliseconds> (
+			next - std::chrono::steady_clock::now ());
+	return std::max<int> (0, remaining.count ());
+}
+
+void DispatcherReactor::stop ()
+{
+	char c = StopReactor;
+	if (-1 == ::write (_pipe[1], &c, sizeof (char)))
+		throw std::system_error (errno, std::system_category (), "write pipe");
+}
+
+std::shared_ptr<DispatcherThread> DispatcherReactor::takeDevice (int fd)
+{
+	// _mutex must be locked
+	auto it = _devices.find (fd);
+	auto dispatcher = std::move (it->second);
+	_devices.erase (it);
+	::epoll_ctl (_epoll, EPOLL_CTL_DEL, fd, nullptr);
+	return dispatcher;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP_DISPATCHER_REACTOR_H
+#define LIBHIDPP_HIDPP_DISPATCHER_REACTOR_H
+
+#include <hidpp/DispatcherThread.h>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace HIDPP
+{
+
+/**
+ * Drives several DispatcherThread from a single thread.
+ *
+ * The reactor waits on all its devices at once (using epoll) and only
+ * reads from the devices that have reports ready. The number of threads
+ * does not depend on the number of devices.
+ *
+ * Devices can be added or removed from any thread while run() is
+ * running. Commands, notifications and event handlers are used through
+ * the returned DispatcherThread as usual, except that event handlers are
+ * called from the reactor thread.
+ *
+ * Only available with the Linux backend.
+ */
+class DispatcherReactor
+{
+public:
+	DispatcherReactor ();
+	~DispatcherReactor ();
+
+	/**
+	 * Open the HID device at \p path and add it to the reactor.
+	 *
+	 * DispatcherThread::run must not be called on the returned
+	 * dispatcher.
+	 *
+	 * \throws Dispatcher::NoHIDPPReportException, std::system_error
+	 */
+	std::shared_ptr<DispatcherThread> addDevice (const char *path);
+
+	/**
+	 * Stop dispatching reports for \p dispatcher.
+	 *
+	 * Pending commands and notifications fail with
+	 * DispatcherThread::NotRunning.
+	 */
+	void removeDevice (const DispatcherThread *dispatcher);
+
+	/**
+	 * Dispatch reports until stop() is called.
+	 *
+	 * Devices failing to read are stopped and removed. When returning,
+	 * all remaining devices are stopped as with removeDevice.
+	 */
+	void run ();
+	void stop ();
+
+private:
+	int _epoll;
+	int _pipe[2];
+	std::mutex _mutex;
+	std::map<int, std::shared_ptr<DispatcherThread>> _devices;
+
+	std::shared_ptr<DispatcherThread> takeDevice (int fd);
+	/**
+	 * Expire the requests of every device.
+	 *
+	 * \returns the time to wait for the next deadline in
+	 * milliseconds, -1 if there is none.
+	 */
+	int expireRequests ();
+};
+
+}
+
+#endif
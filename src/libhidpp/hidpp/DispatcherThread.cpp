@@ -21,25 +21,40 @@
 #include <hidpp10/Error.h>
 #include <hidpp20/Error.h>
 #include <misc/Log.h>
-#include <memory>
 #include <algorithm>
+#include <memory>
 
 using namespace HIDPP;
 
 template<typename Iterator,
-	 void (DispatcherThread::*cancel) (Iterator),
+	 void (DispatcherThread::*cancel) (Iterator, bool),
 	 std::mutex DispatcherThread::*mutex>
 class DispatcherThread::AsyncReport: public Dispatcher::AsyncReport
 {
 	DispatcherThread *dispatcher;
 	std::future<Report> report;
 	Iterator it;
+	bool cancelled;
 public:
 	AsyncReport (DispatcherThread *dispatcher, std::future<Report> &&report, Iterator it):
-		dispatcher (dispatcher), report (std::move (report)), it (it)
+		dispatcher (dispatcher), report (std::move (report)), it (it), cancelled (false)
 	{
 	}
 
+	virtual ~AsyncReport ()
+	{
+		// Free the pending entry if the report will never be read,
+		// so it cannot take a later report.
+		// Answered reports need no lock.
+		if (cancelled || !report.valid () ||
+		    report.wait_for (std::chrono::milliseconds (0)) == std::future_status::ready)
+			return;
+		std::unique_lock<std::mutex> lock (dispatcher->*mutex);
+		// The report may have been answered before the lock.
+		if (report.wait_for (std::chrono::milliseconds (0)) != std::future_status::ready)
+			(dispatcher->*cancel) (it, false);
+	}
+
 	virtual Report get ()
 	{
 		return report.get ();
@@ -54,7 +69,9 @@ public:
 			auto status = report.wait_for (std::chrono::milliseconds (0));
 			if (status != std::future_status::ready) {
 				// cancel the command
-				(dispatcher->*cancel) (it);
+				(dispatcher->*cancel) (it, true);
+				cancelled = true;
+				dispatcher->_metrics.increment (DispatcherMetrics::Timeouts);
 				throw Dispatcher::TimeoutError ();
 			}
 		}
@@ -64,9 +81,14 @@ public:
 
 DispatcherThread::DispatcherThread (const char *path):
 	_dev (path),
-	_stopped (false)
+	_reports (ReportBatchSize, MaxReportLength),
+	_next_notification_id (0),
+	_stopped (false),
+	_wait_deadline (time_point::min ())
 {
 	checkReportDescriptor (_dev.getReportDescriptor ());
+	_events.reserve (ReportBatchSize);
+	_completions.reserve (ReportBatchSize);
 }
 
 DispatcherThread::~DispatcherThread ()
@@ -78,6 +100,11 @@ const HID::RawDevice &DispatcherThread::hidraw () const
 	return _dev;
 }
 
+void DispatcherThread::setRawTimestamps (bool enabled)
+{
+	_dev.setRawTimestamps (enabled);
+}
+
 uint16_t DispatcherThread::vendorID () const
 {
 	return _dev.vendorID ();
@@ -96,108 +123,277 @@ std::string DispatcherThread::name () const
 void DispatcherThread::sendCommandWithoutResponse (const Report &report)
 {
 	_dev.writeReport (report.rawReport ());
+	_metrics.increment (DispatcherMetrics::CommandsSent);
 }
 
 std::unique_ptr<Dispatcher::AsyncReport> DispatcherThread::sendCommand (Report &&report)
+{
+	std::promise<Report> response;
+	auto future = response.get_future ();
+	auto it = addCommand (std::move (report), std::move (response));
+	return std::make_unique<AsyncCommandResponse> (this, std::move (future), it);
+}
+
+std::unique_ptr<Dispatcher::AsyncReport> DispatcherThread::getNotification (DeviceIndex index, uint8_t sub_id)
+{
+	std::promise<Report> notification;
+	auto future = notification.get_future ();
+	auto it = addNotification (index, sub_id, std::move (notification));
+	return std::make_unique<AsyncNotification> (this, std::move (future), it);
+}
+
+void DispatcherThread::sendCommand (Report &&report, report_handler &&handler, int timeout)
+{
+	auto limit = deadline (timeout);
+	addCommand (std::move (report), std::move (handler), limit);
+	armDeadline (limit);
+}
+
+void DispatcherThread::getNotification (DeviceIndex index, uint8_t sub_id, report_handler &&handler, int timeout)
+{
+	auto limit = deadline (timeout);
+	addNotification (index, sub_id, std::move (handler), limit);
+	armDeadline (limit);
+}
+
+DispatcherThread::time_point DispatcherThread::deadline (int timeout)
+{
+	if (timeout < 0)
+		return time_point::max ();
+	return std::chrono::steady_clock::now () + std::chrono::milliseconds (timeout);
+}
+
+DispatcherThread::command_iterator DispatcherThread::addCommand (Report &&report, response_receiver &&response,
+								 time_point deadline)
 {
 	std::unique_lock<std::mutex> lock (_command_mutex);
 	if (_stopped)
-		throw _exception;
+		std::rethrow_exception (_exception);
+	auto key = command_container::key (report.deviceIndex (), report.subID (), report.address ());
+	if (_commands.full ())
+		throw command_container::Full ();
 	_dev.writeReport (report.rawReport ());
-	auto it = _commands.insert (_commands.end (), Command { std::move (report) });
-	return std::make_unique<AsyncCommandResponse> (this, it->response.get_future (), it);
+	_metrics.increment (DispatcherMetrics::CommandsSent);
+	auto sent = std::chrono::steady_clock::now ();
+	return _commands.insert (key, Command { std::move (report), std::move (response), sent, deadline });
 }
 
-std::unique_ptr<Dispatcher::AsyncReport> DispatcherThread::getNotification (DeviceIndex index, uint8_t sub_id)
+DispatcherThread::notification_iterator DispatcherThread::addNotification (DeviceIndex index, uint8_t sub_id, response_receiver &&notification,
+									   time_point deadline)
 {
 	std::unique_lock<std::mutex> lock (_listener_mutex);
 	if (_stopped)
-		throw _exception;
-	auto it = _notifications.emplace (_notifications.end ());
-	it->listener = Dispatcher::registerEventHandler (index, sub_id, [this, it] (const Report &report) {
-		it->notification.set_value (report);
+		std::rethrow_exception (_exception);
+	auto id = _next_notification_id++;
+	auto it = _notifications.emplace (id, Notification { {}, std::move (notification), deadline }).first;
+	it->second.listener = Dispatcher::registerEventHandler (index, sub_id, [this, id] (const Report &report) {
+		// only called from receiveReport
+		std::unique_lock<std::mutex> lock (_listener_mutex);
+		auto it = _notifications.find (id);
+		if (it == _notifications.end ())
+			return false; // cancelled while the event was processed
+		complete (it->second.notification, &report, nullptr, _completions);
 		_notifications.erase (it);
 		return false;
 	});
-	return std::make_unique<AsyncNotification> (this, it->notification.get_future (), it);
+	return it;
 }
 
-DispatcherThread::listener_iterator DispatcherThread::registerEventHandler (DeviceIndex index, uint8_t sub_id, const event_handler &handler)
+void DispatcherThread::cancelCommand (command_iterator it, bool timed_out)
 {
-	std::unique_lock<std::mutex> lock (_listener_mutex);
-	return Dispatcher::registerEventHandler (index, sub_id, handler);
+	auto cmd = _commands.take (it);
+	if (cmd && timed_out)
+		_metrics.recordCommandTimeout (cmd->request.deviceIndex ());
 }
 
-void DispatcherThread::unregisterEventHandler (listener_iterator it)
+DispatcherThread::time_point DispatcherThread::expireRequests ()
 {
-	std::unique_lock<std::mutex> lock (_listener_mutex);
-	Dispatcher::unregisterEventHandler (it);
+	// Requests added during the scan wake the dispatching thread.
+	_wait_deadline = time_point::min ();
+	auto now = std::chrono::steady_clock::now ();
+	auto next = time_point::max ();
+	auto timeout = std::make_exception_ptr (Dispatcher::TimeoutError ());
+	{
+		std::unique_lock<std::mutex> lock (_command_mutex);
+		_commands.takeIf ([now, &next] (const Command &cmd) {
+			if (cmd.deadline <= now)
+				return true;
+			next = std::min (next, cmd.deadline);
+			return false;
+		}, [this, &timeout] (Command &&cmd) {
+			_metrics.increment (DispatcherMetrics::Timeouts);
+			_metrics.recordCommandTimeout (cmd.request.deviceIndex ());
+			complete (cmd.response, nullptr, timeout, _completions);
+		});
+	}
+	{
+		std::unique_lock<std::mutex> lock (_listener_mutex);
+		for (auto it = _notifications.begin (); it != _notifications.end ();) {
+			if (it->second.deadline <= now) {
+				complete (it->second.notification, nullptr, timeout, _completions);
+				removeListener (it->second.listener);
+				it = _notifications.erase (it);
+			}
+			else {
+				next = std::min (next, it->second.deadline);
+				++it;
+			}
+		}
+	}
+	runCompletions (_completions);
+	return next;
 }
 
-void DispatcherThread::cancelCommand (command_iterator it)
+void DispatcherThread::setWaitDeadline (time_point deadline)
 {
-	_commands.erase (it);
+	_wait_deadline = deadline;
 }
 
-void DispatcherThread::cancelNotification (notification_iterator it)
+void DispatcherThread::armDeadline (time_point deadline)
 {
-	Dispatcher::unregisterEventHandler (it->listener);
+	if (deadline == time_point::max ())
+		return;
+	auto waiting = _wait_deadline.load ();
+	if (waiting != time_point::min () && deadline >= waiting)
+		return;
+	if (_wake_up)
+		_wake_up ();
+	else
+		_dev.interruptRead ();
+}
+
+void DispatcherThread::cancelNotification (notification_iterator it, bool)
+{
+	// The handler takes _listener_mutex and ignores cancelled
+	// notifications, do not wait for it.
+	removeListener (it->second.listener);
 	_notifications.erase (it);
 }
 
+void DispatcherThread::complete (response_receiver &receiver,
+				 const Report *report, std::exception_ptr error,
+				 completion_container &completions)
+{
+	if (auto promise = std::get_if<std::promise<Report>> (&receiver)) {
+		if (report)
+			promise->set_value (*report);
+		else
+			promise->set_exception (error);
+	}
+	else {
+		auto &handler = std::get<report_handler> (receiver);
+		if (report)
+			completions.push_back ({ std::move (handler), *report, nullptr });
+		else
+			completions.push_back ({ std::move (handler), std::nullopt, error });
+	}
+}
+
+void DispatcherThread::runCompletions (completion_container &completions)
+{
+	for (auto &c: completions) {
+		if (c.report)
+			c.handler (&*c.report, nullptr);
+		else
+			c.handler (nullptr, c.error);
+	}
+	completions.clear ();
+}
+
 void DispatcherThread::run ()
 {
 	while (!_stopped) {
 		try {
-			std::vector<uint8_t> raw_report (MaxReportLength);
-			if (0 != _dev.readReport (raw_report))
-				processReport (std::move (raw_report));
-		}
-		catch (Report::InvalidReportID &e) {
-			// There may be other reports on this device, just ignore them.
-		}
-		catch (Report::InvalidReportLength &e) {
-			Log::error () << "Ignored report with invalid length" << std::endl;
+			auto next = expireRequests ();
+			setWaitDeadline (next);
+			int timeout = -1;
+			if (next != time_point::max ()) {
+				auto remaining = std::chrono::ceil<std::chrono::milliseconds> (
+						next - std::chrono::steady_clock::now ());
+				timeout = std::max<int> (0, remaining.count ());
+			}
+			receiveReport (timeout);
 		}
 		catch (std::exception &e) {
 			Log::error () << "Failed to read HID report: " << e.what () << std::endl;
-			_exception = std::current_exception ();
-			goto stop;
+			finish (std::current_exception ());
+			return;
 		}
 	}
-	_exception = std::make_exception_ptr (NotRunning ());
-stop:
+	finish (std::make_exception_ptr (NotRunning ()));
+}
+
+void DispatcherThread::stop ()
+{
 	_stopped = true;
+	_dev.interruptRead ();
+}
+
+bool DispatcherThread::receiveReport (int timeout)
+{
+	if (0 == _dev.readReports (_reports, timeout))
+		return false;
+	_events.clear ();
+	{
+		std::unique_lock<std::mutex> lock (_command_mutex);
+		for (; !_reports.empty (); _reports.pop ()) {
+			try {
+				Report report (_reports.front ());
+				report.setTimestamp (_reports.frontTimestamp ());
+				if (!processResponse (report))
+					_events.push_back (std::move (report));
+			}
+			catch (Report::InvalidReportID &e) {
+				// There may be other reports on this device, just ignore them.
+			}
+			catch (Report::InvalidReportLength &e) {
+				Log::error () << "Ignored report with invalid length" << std::endl;
+			}
+		}
+	}
+	runCompletions (_completions);
+	if (!_events.empty ()) {
+		for (const auto &event: _events) {
+			// Events may announce a change of the state read by queries.
+			invalidateQueries (event.deviceIndex (), event.subID ());
+			processEvent (event);
+		}
+		runCompletions (_completions);
+	}
+	return true;
+}
+
+void DispatcherThread::finish (std::exception_ptr exception)
+{
+	_exception = exception;
+	_stopped = true;
+	completion_container completions;
 	{
 		std::unique_lock<std::mutex> lock (_command_mutex);
 		if (!_commands.empty ()) {
 			Log::warning () << "Unfinished commands while stopping dispatcher." << std::endl;
-			for (auto &cmd: _commands) {
-				cmd.response.set_exception (_exception);
-			}
+			_commands.forEach ([this, &completions] (Command &cmd) {
+				complete (cmd.response, nullptr, _exception, completions);
+			});
+			_commands.clear ();
 		}
 	}
 	{
 		std::unique_lock<std::mutex> lock (_listener_mutex);
 		if (!_notifications.empty ()) {
 			Log::warning () << "Unreceived notifications while stopping dispatcher." << std::endl;
-			for (auto &n: _notifications) {
-				n.notification.set_exception (_exception);
+			for (auto &[id, n]: _notifications) {
+				complete (n.notification, nullptr, _exception, completions);
+				removeListener (n.listener);
 			}
+			_notifications.clear ();
 		}
 	}
+	runCompletions (completions);
 }
 
-void DispatcherThread::stop ()
-{
-	_stopped = true;
-	_dev.interruptRead ();
-}
-
-void DispatcherThread::processReport (std::vector<uint8_t> &&raw_report)
+bool DispatcherThread::processResponse (Report &report)
 {
-
-	Report report (std::move (raw_report));
 	DeviceIndex index = report.deviceIndex ();
 
 	uint8_t sub_id, address, feature, error_code;
@@ -205,47 +401,32 @@ void DispatcherThread::processReport (std::vector<uint8_t> &&raw_report)
 	std::vector<uint8_t> error_data;
 
 	if (report.checkErrorMessage10 (&sub_id, &address, &error_code)) {
-		std::unique_lock<std::mutex> lock (_command_mutex);
-		auto it = std::find_if (_commands.begin (), _commands.end (),
-			[index, sub_id, address] (const Command &cmd) {
-				return index == cmd.request.deviceIndex () &&
-					sub_id == cmd.request.subID () &&
-					address == cmd.request.address ();
-			});
-		if (it != _commands.end ()) {
-			it->response.set_exception (std::make_exception_ptr (HIDPP10::Error (error_code)));
-			_commands.erase (it);
+		_metrics.increment (DispatcherMetrics::HIDPP10Errors);
+		if (auto cmd = _commands.take (command_container::key (index, sub_id, address))) {
+			_metrics.recordRoundTripTime (index, sub_id, report.timestamp ().monotonic - cmd->sent);
+			complete (cmd->response, nullptr, std::make_exception_ptr (HIDPP10::Error (error_code)), _completions);
 		}
-		else
+		else {
+			_metrics.increment (DispatcherMetrics::UnmatchedAnswers);
 			Log::warning () << "HID++1.0 error message was not matched with any command." << std::endl;
+		}
 	}
 	else if (report.checkErrorMessage20 (&feature, &function, &sw_id, &error_code, &error_data)) {
-		std::unique_lock<std::mutex> lock (_command_mutex);
-		auto it = std::find_if (_commands.begin (), _commands.end (),
-			[index, feature, function, sw_id] (const Command &cmd) {
-				return index == cmd.request.deviceIndex () &&
-					feature == cmd.request.featureIndex () &&
-					function == cmd.request.function () &&
-					sw_id == cmd.request.softwareID ();
-			});
-		if (it != _commands.end ()) {
-			it->response.set_exception (std::make_exception_ptr (HIDPP20::Error (error_code, std::move(error_data))));
-			_commands.erase (it);
+		_metrics.increment (DispatcherMetrics::HIDPP20Errors);
+		if (auto cmd = _commands.take (command_container::key (index, feature, (function & 0x0f) << 4 | (sw_id & 0x0f)))) {
+			_metrics.recordRoundTripTime (index, feature, report.timestamp ().monotonic - cmd->sent);
+			complete (cmd->response, nullptr, std::make_exception_ptr (HIDPP20::Error (error_code, std::move(error_data))), _completions);
 		}
-		else
+		else {
+			_metrics.increment (DispatcherMetrics::UnmatchedAnswers);
 			Log::warning () << "HID++2.0 error message was not matched with any command." << std::endl;
+		}
 	}
 	else {
-		std::unique_lock<std::mutex> cmd_lock (_command_mutex);
-		auto it = std::find_if (_commands.begin (), _commands.end (),
-			[&report] (const Command &cmd) {
-				return report.deviceIndex () == cmd.request.deviceIndex () &&
-					report.subID () == cmd.request.subID () &&
-					report.address () == cmd.request.address ();
-			});
-		if (it != _commands.end ()) {
-			it->response.set_value (std::move (report));
-			_commands.erase (it);
+		if (auto cmd = _commands.take (command_container::key (index, report.subID (), report.address ()))) {
+			_metrics.increment (DispatcherMetrics::ResponsesMatched);
+			_metrics.recordRoundTripTime (index, report.subID (), report.timestamp ().monotonic - cmd->sent);
+			complete (cmd->response, &report, nullptr, _completions);
 		}
 		else if (report.softwareID () == 0 || report.subID () < 0x80) { // is an event
 			// TODO: fix this test, HID++2.0 answers could
@@ -254,14 +435,14 @@ void DispatcherThread::processReport (std::vector<uint8_t> &&raw_report)
 			// But the lowest known HID++1.0 notification is 0x40,
 			// if no HID++2.0 device has more than 64 features,
 			// there should be no confusion in practice.
-			cmd_lock.unlock ();
-			std::unique_lock<std::mutex> lock (_listener_mutex);
-			processEvent (report);
+			return false;
 		}
 		else {
+			_metrics.increment (DispatcherMetrics::UnmatchedAnswers);
 			Log::warning () << "Answer was not matched with any command." << std::endl;
 		}
 	}
+	return true;
 }
 
 const char *DispatcherThread::NotRunning::what () const noexcept
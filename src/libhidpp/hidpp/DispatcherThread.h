@@ -20,15 +20,27 @@
 #define LIBHIDPP_HIDPP_DISPATCHER_THREAD_H
 
 #include <hidpp/Dispatcher.h>
+#include <hidpp/CommandTable.h>
 #include <hid/RawDevice.h>
 #include <future>
-#include <list>
 #include <map>
 #include <chrono>
+#include <atomic>
+#include <functional>
+#include <variant>
 
 namespace HIDPP
 {
 
+class DispatcherReactor;
+
+/**
+ * Thread-safe dispatcher.
+ *
+ * Reports are read and dispatched by run(), that must be called from
+ * a dedicated thread. Alternatively, several instances can be driven by
+ * a single DispatcherReactor, run() must not be called in that case.
+ */
 class DispatcherThread: public Dispatcher
 {
 public:
@@ -43,52 +55,164 @@ public:
 
 	const HID::RawDevice &hidraw () const;
 
+	/**
+	 * \sa HID::RawDevice::setRawTimestamps
+	 */
+	void setRawTimestamps (bool enabled);
+
 	virtual uint16_t vendorID () const;
 	virtual uint16_t productID () const;
 	virtual std::string name () const;
 	virtual void sendCommandWithoutResponse (const Report &report);
 	virtual std::unique_ptr<Dispatcher::AsyncReport> sendCommand (Report &&report);
 	virtual std::unique_ptr<Dispatcher::AsyncReport> getNotification (DeviceIndex index, uint8_t sub_id);
-
-
-	virtual listener_iterator registerEventHandler (DeviceIndex index, uint8_t sub_id, const event_handler &handler);
-	virtual void unregisterEventHandler (listener_iterator it);
+	/**
+	 * \p handler is called from the thread dispatching reports, it is
+	 * given a TimeoutError when \p timeout expires.
+	 */
+	virtual void sendCommand (Report &&report, report_handler &&handler, int timeout = -1);
+	virtual void getNotification (DeviceIndex index, uint8_t sub_id, report_handler &&handler, int timeout = -1);
 
 	void run ();
 	void stop ();
 
 private:
+	/**
+	 * Receives an answer or a notification either through a future
+	 * (AsyncReport) or a callback.
+	 */
+	typedef std::variant<std::promise<Report>, report_handler> response_receiver;
+	/**
+	 * Callback call delayed until no lock is held.
+	 */
+	struct Completion
+	{
+		report_handler handler;
+		std::optional<Report> report;
+		std::exception_ptr error;
+	};
+	typedef std::vector<Completion> completion_container;
+	/**
+	 * Give \p report or \p error to \p receiver. Callbacks are
+	 * added to \p completions instead of being called.
+	 */
+	static void complete (response_receiver &receiver,
+			      const Report *report, std::exception_ptr error,
+			      completion_container &completions);
+	/**
+	 * Call and remove all \p completions.
+	 */
+	static void runCompletions (completion_container &completions);
+
+	typedef std::chrono::steady_clock::time_point time_point;
+	/**
+	 * Deadline for \p timeout milliseconds from now,
+	 * time_point::max () if \p timeout is negative.
+	 */
+	static time_point deadline (int timeout);
+
 	struct Command
 	{
 		Report request;
-		std::promise<Report> response;
+		response_receiver response;
+		time_point sent;
+		time_point deadline;
 	};
-	typedef std::list<Command> command_container;
-	typedef command_container::iterator command_iterator;
-
-	void cancelCommand (command_iterator);
+	/**
+	 * Maximum number of commands waiting for a response.
+	 */
+	static constexpr std::size_t MaxPendingCommands = 64;
+	typedef CommandTable<Command, MaxPendingCommands> command_container;
+	typedef command_container::Handle command_iterator;
+
+	/**
+	 * Remove a command that timed out or whose response is not
+	 * awaited anymore, _command_mutex must be locked.
+	 */
+	void cancelCommand (command_iterator, bool timed_out);
+	command_iterator addCommand (Report &&report, response_receiver &&response,
+				     time_point deadline = time_point::max ());
 
 	struct Notification
 	{
 		listener_iterator listener;
-		std::promise<Report> notification;
+		response_receiver notification;
+		time_point deadline;
 	};
-	typedef std::list<Notification> notification_container;
+	typedef std::map<unsigned int, Notification> notification_container;
 	typedef notification_container::iterator notification_iterator;
 
-	void cancelNotification (notification_iterator);
-
-	void processReport (std::vector<uint8_t> &&raw_report);
+	void cancelNotification (notification_iterator, bool timed_out);
+	notification_iterator addNotification (DeviceIndex index, uint8_t sub_id, response_receiver &&notification,
+					       time_point deadline = time_point::max ());
+
+	/**
+	 * Complete the commands and notifications whose deadline has
+	 * passed with a TimeoutError. Only called from the thread
+	 * dispatching reports, which must then wait at most until the
+	 * returned deadline (see setWaitDeadline).
+	 *
+	 * \returns the nearest deadline of the remaining requests.
+	 */
+	time_point expireRequests ();
+	/**
+	 * Tell until when the thread dispatching reports is waiting.
+	 * Requests with an earlier deadline wake it up.
+	 */
+	void setWaitDeadline (time_point deadline);
+	/**
+	 * Wake the thread dispatching reports if \p deadline is earlier
+	 * than the end of its wait.
+	 */
+	void armDeadline (time_point deadline);
+
+	/**
+	 * Read and process all queued reports.
+	 *
+	 * Responses of the whole batch are matched under a single lock
+	 * of the command table, events are dispatched after it is released
+	 * without taking any lock.
+	 *
+	 * Errors that are not fatal for the dispatcher (e.g. report that
+	 * are not HID++ reports) are logged and ignored.
+	 *
+	 * \returns false if the read timed out or was interrupted.
+	 */
+	bool receiveReport (int timeout);
+	/**
+	 * Match \p report with pending commands, _command_mutex must be locked.
+	 *
+	 * \returns false if \p report is an event.
+	 */
+	bool processResponse (Report &report);
+	/**
+	 * Stop the dispatcher, pending commands and notifications
+	 * are given \p exception.
+	 */
+	void finish (std::exception_ptr exception);
+
+	/**
+	 * Maximum number of reports read in a single batch.
+	 */
+	static constexpr std::size_t ReportBatchSize = 32;
 
 	HID::RawDevice _dev;
+	HID::ReportRing _reports;
+	std::vector<Report> _events;
+	completion_container _completions;
 	command_container _commands;
 	notification_container _notifications;
-	std::mutex _command_mutex, _listener_mutex;
-	bool _stopped;
+	unsigned int _next_notification_id;
+	std::mutex _command_mutex, _listener_mutex; // _listener_mutex protects _notifications
+	std::atomic<bool> _stopped;
 	std::exception_ptr _exception;
+	// time_point::min () while expireRequests is scanning the requests
+	std::atomic<time_point> _wait_deadline;
+	// Wakes the thread dispatching reports, set by DispatcherReactor.
+	std::function<void ()> _wake_up;
 
 	template<typename Iterator,
-		 void (DispatcherThread::*cancel) (Iterator),
+		 void (DispatcherThread::*cancel) (Iterator, bool),
 		 std::mutex DispatcherThread::*mutex>
 	class AsyncReport;
 	using AsyncCommandResponse = DispatcherThread::AsyncReport<
@@ -101,6 +225,8 @@ private:
 		&DispatcherThread::cancelNotification,
 		&DispatcherThread::_listener_mutex>;
 	friend AsyncNotification;
+
+	friend DispatcherReactor;
 };
 
 }
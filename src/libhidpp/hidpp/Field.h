@@ -19,6 +19,7 @@
 #ifndef LIBHIDPP_HIDPP_FIELD_H
 #define LIBHIDPP_HIDPP_FIELD_H
 
+#include <hidpp/Setting.h>
 #include <misc/Endian.h>
 
 namespace HIDPP
@@ -222,11 +222,13 @@ Macro::Macro (const AbstractMacroFormat &format, AbstractMemoryMapping &mem, Add
 	std::map<Address, iterator> parsed_items;
 	std::vector<std::pair <Item *, Address>> incomplete_ref;
 
-	std::vector<uint8_t>::const_iterator current = mem.getReadOnlyIterator (address);
+	// Only read the memory used by the macro items.
+	std::vector<uint8_t>::const_iterator current = mem.getReadOnlyIterator (address, format.getMaxLength ());
 
 	std::stack<Address> jump_dests;
 	while (true) {
 		Address dest;
+		mem.readRange (address, current, format.getMaxLength ());
 		auto last = current;
 		_items.emplace_back (format.parseItem (current, dest));
 		Item &item = _items.back ();
@@ -250,7 +252,7 @@ Macro::Macro (const AbstractMacroFormat &format, AbstractMemoryMapping &mem, Add
 				jump_dests.pop ();
 			} while (parsed_items.find (address) != parsed_items.end ());
 
-			current = mem.getReadOnlyIterator (address);
+			current = mem.getReadOnlyIterator (address, format.getMaxLength ());
 		}
 	}
 parse_end:
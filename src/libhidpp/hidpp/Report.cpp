@@ -58,21 +58,25 @@ Report::Report (uint8_t report_id, const uint8_t *data, std::size_t length)
 	auto expected_len = reportLength (static_cast<Type> (report_id));
 	if (expected_len == 0)
 		throw InvalidReportID ();
-	_data.resize (expected_len);
 	if (length != expected_len-1)
 		throw InvalidReportLength ();
+	_length = expected_len;
 	_data[Offset::Type] = report_id;
 	std::copy_n (data, length, &_data[1]);
 }
 
-Report::Report (std::vector<uint8_t> &&data)
+Report::Report (std::span<const uint8_t> data)
 {
+	static_assert (MaxLength == MaxReportLength);
+	if (data.empty ())
+		throw InvalidReportLength ();
 	auto expected_len = reportLength (static_cast<Type> (data[0]));
 	if (expected_len == 0)
 		throw InvalidReportID ();
 	if (data.size () != expected_len)
 		throw InvalidReportLength ();
-	_data = std::move (data);
+	_length = expected_len;
+	std::copy (data.begin (), data.end (), _data.begin ());
 }
 
 Report::Report (Type type,
@@ -80,7 +84,8 @@ Report::Report (Type type,
 		uint8_t sub_id,
 		uint8_t address)
 {
-	_data.resize (reportLength (type), 0);
+	_length = reportLength (type);
+	std::fill_n (_data.begin (), _length, 0);
 	_data[Offset::Type] = type;
 	_data[Offset::DeviceIndex] = device_index;
 	_data[Offset::SubID] = sub_id;
@@ -94,14 +99,15 @@ Report::Report (HIDPP::DeviceIndex device_index,
 		std::vector<uint8_t>::const_iterator param_end)
 {
 	std::size_t param_len = std::distance (param_begin, param_end);
+	_length = 0;
 	for (auto type: { Short, Long, VeryLong }) {
 		if (param_len == parameterLength (type)) {
-			_data.resize (reportLength (type));
+			_length = reportLength (type);
 			_data[Offset::Type] = type;
 			break;
 		}
 	}
-	if (_data.empty ())
+	if (_length == 0)
 		throw InvalidReportLength ();
 	_data[Offset::DeviceIndex] = device_index;
 	_data[Offset::SubID] = sub_id;
@@ -115,7 +121,8 @@ Report::Report (Type type,
 		unsigned int function,
 		unsigned int sw_id)
 {
-	_data.resize (reportLength (type), 0);
+	_length = reportLength (type);
+	std::fill_n (_data.begin (), _length, 0);
 	_data[Offset::Type] = type;
 	_data[Offset::DeviceIndex] = device_index;
 	_data[Offset::SubID] = feature_index;
@@ -130,14 +137,15 @@ Report::Report (DeviceIndex device_index,
 		std::vector<uint8_t>::const_iterator param_end)
 {
 	std::size_t param_len = std::distance (param_begin, param_end);
+	_length = 0;
 	for (auto type: { Short, Long, VeryLong }) {
 		if (param_len == parameterLength (type)) {
-			_data.resize (reportLength (type));
+			_length = reportLength (type);
 			_data[Offset::Type] = type;
 			break;
 		}
 	}
-	if (_data.empty ())
+	if (_length == 0)
 		throw InvalidReportLength ();
 	_data[Offset::DeviceIndex] = device_index;
 	_data[Offset::SubID] = feature_index;
@@ -210,29 +218,49 @@ std::size_t Report::parameterLength () const
 	return parameterLength (static_cast<Type> (_data[Offset::Type]));
 }
 
-std::vector<uint8_t>::iterator Report::parameterBegin ()
+Report::iterator Report::parameterBegin ()
 {
 	return _data.begin () + Offset::Parameters;
 }
 
-std::vector<uint8_t>::const_iterator Report::parameterBegin () const
+Report::const_iterator Report::parameterBegin () const
 {
 	return _data.begin () + Offset::Parameters;
 }
 
-std::vector<uint8_t>::iterator Report::parameterEnd ()
+Report::iterator Report::parameterEnd ()
+{
+	return _data.begin () + _length;
+}
+
+Report::const_iterator Report::parameterEnd () const
+{
+	return _data.begin () + _length;
+}
+
+std::span<uint8_t> Report::parameters ()
+{
+	return std::span<uint8_t> (_data.data () + Offset::Parameters, _length - Offset::Parameters);
+}
+
+std::span<const uint8_t> Report::parameters () const
+{
+	return std::span<const uint8_t> (_data.data () + Offset::Parameters, _length - Offset::Parameters);
+}
+
+std::span<const uint8_t> Report::rawReport () const
 {
-	return _data.end ();
+	return std::span<const uint8_t> (_data.data (), _length);
 }
 
-std::vector<uint8_t>::const_iterator Report::parameterEnd () const
+const HID::Timestamp &Report::timestamp () const
 {
-	return _data.end ();
+	return _timestamp;
 }
 
-const std::vector<uint8_t> &Report::rawReport () const
+void Report::setTimestamp (const HID::Timestamp &timestamp)
 {
-	return _data;
+	_timestamp = timestamp;
 }
 
 bool Report::checkErrorMessage10 (uint8_t *sub_id,
@@ -272,7 +300,7 @@ bool Report::checkErrorMessage20 (uint8_t *feature_index,
 
 	if (error_data)
 	{
-		size_t offset = _data.size() - 1;
+		size_t offset = _length - 1;
 		while(offset >= 6 && _data[offset] == 0x00)		// Look for the last non-zero byte
 			--offset;
 		*error_data = { _data.data() + 6, _data.data() + offset + 1 };	// Copy the error data
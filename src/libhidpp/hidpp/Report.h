@@ -21,8 +21,10 @@
 
 #include <hidpp/defs.h>
 #include <hid/ReportDescriptor.h>
+#include <hid/Timestamp.h>
 
 #include <array>
+#include <span>
 #include <vector>
 
 namespace HIDPP
@@ -52,7 +54,12 @@ namespace HIDPP
 class Report
 {
 	static constexpr std::size_t HeaderLength = 4;
+	static constexpr std::size_t MaxLength = 64;
+	typedef std::array<uint8_t, MaxLength> storage_type;
 public:
+	typedef storage_type::iterator iterator;
+	typedef storage_type::const_iterator const_iterator;
+
 	enum Type: uint8_t {
 		Short = 0x10,
 		Long = 0x11,
@@ -110,14 +117,16 @@ public:
 	Report (uint8_t report_id, const uint8_t *data, std::size_t length);
 
 	/**
-	 * Build the report by moving the raw data.
+	 * Build the report by copying the raw data.
+	 *
+	 * The report is stored inline, no memory is allocated.
 	 *
 	 * \param data	Report data including the report ID in its first byte.
 	 *
 	 * \throws InvalidReportID
 	 * \throws InvalidReportLength
 	 */
-	Report (std::vector<uint8_t> &&data);
+	Report (std::span<const uint8_t> data);
 
 	/**
 	 * Access report type.
@@ -273,21 +282,37 @@ public:
 	std::size_t parameterLength () const;
 
 	/** Begin iterator for parameters. */
-	std::vector<uint8_t>::iterator parameterBegin ();
+	iterator parameterBegin ();
 	/** Begin iterator for parameters. */
-	std::vector<uint8_t>::const_iterator parameterBegin () const;
+	const_iterator parameterBegin () const;
 	/** End iterator for parameters. */
-	std::vector<uint8_t>::iterator parameterEnd ();
+	iterator parameterEnd ();
 	/** End iterator for parameters. */
-	std::vector<uint8_t>::const_iterator parameterEnd () const;
+	const_iterator parameterEnd () const;
+
+	/** Access parameters. */
+	std::span<uint8_t> parameters ();
+	/** Access parameters. */
+	std::span<const uint8_t> parameters () const;
 
 	/**
-	 * Get the raw HID report (without the ID).
+	 * Get the raw HID report (including the ID).
+	 */
+	std::span<const uint8_t> rawReport () const;
+
+	/**
+	 * Time when the report was read from the device.
+	 *
+	 * Reports that were not received from a device have a zero
+	 * timestamp.
 	 */
-	const std::vector<uint8_t> &rawReport () const;
+	const HID::Timestamp &timestamp () const;
+	void setTimestamp (const HID::Timestamp &timestamp);
 
 private:
-	std::vector<uint8_t> _data;
+	storage_type _data;
+	std::size_t _length;
+	HID::Timestamp _timestamp = {};
 };
 
 inline constexpr auto MaxReportLength = Report::reportLength (Report::VeryLong);
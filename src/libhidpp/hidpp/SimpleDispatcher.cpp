@@ -41,6 +41,11 @@ const HID::RawDevice &SimpleDispatcher::hidraw () const
 	return _dev;
 }
 
+void SimpleDispatcher::setRawTimestamps (bool enabled)
+{
+	_dev.setRawTimestamps (enabled);
+}
+
 uint16_t SimpleDispatcher::vendorID () const
 {
 	return _dev.vendorID ();
@@ -59,14 +64,32 @@ std::string SimpleDispatcher::name () const
 void SimpleDispatcher::sendCommandWithoutResponse (const Report &report)
 {
 	_dev.writeReport (report.rawReport ());
+	_metrics.increment (DispatcherMetrics::CommandsSent);
 }
 
 std::unique_ptr<Dispatcher::AsyncReport> SimpleDispatcher::sendCommand (Report &&report)
 {
 	_dev.writeReport (report.rawReport ());
+	_metrics.increment (DispatcherMetrics::CommandsSent);
 	return std::make_unique<CommandResponse> (this, std::move (report));
 }
 
+void SimpleDispatcher::sendCommand (Report &&report, report_handler &&handler, int timeout)
+{
+	std::optional<Report> response;
+	try {
+		_dev.writeReport (report.rawReport ());
+		_metrics.increment (DispatcherMetrics::CommandsSent);
+		CommandResponse command (this, std::move (report));
+		response.emplace (command.get (timeout));
+	}
+	catch (...) {
+		handler (nullptr, std::current_exception ());
+		return;
+	}
+	handler (&*response, nullptr);
+}
+
 std::unique_ptr<Dispatcher::AsyncReport> SimpleDispatcher::getNotification (DeviceIndex index, uint8_t sub_id)
 {
 	return std::make_unique<Notification> (this, index, sub_id);
@@ -77,8 +100,9 @@ void SimpleDispatcher::listen ()
 	auto debug = Log::debug ("dispatcher");
 	try {
 		while (true) {
-			Report report = getReport ();
-			debug << "Ignored report while listening for events." << std::endl;
+			auto report = getReport ();
+			if (!matchResponse (report))
+				debug << "Ignored report while listening for events." << std::endl;
 		}
 	}
 	catch (Dispatcher::TimeoutError &e) {
@@ -91,14 +115,28 @@ void SimpleDispatcher::stop ()
 	_dev.interruptRead ();
 }
 
+Report SimpleDispatcher::getReportOrCountTimeout (int timeout)
+{
+	try {
+		return getReport (timeout);
+	}
+	catch (Dispatcher::TimeoutError &e) {
+		_metrics.increment (DispatcherMetrics::Timeouts);
+		throw;
+	}
+}
+
 Report SimpleDispatcher::getReport (int timeout)
 {
 	while (true) {
-		std::vector<uint8_t> raw_report (MaxReportLength);
-		if (0 == _dev.readReport (raw_report, timeout))
+		std::array<uint8_t, MaxReportLength> buffer;
+		HID::Timestamp timestamp;
+		int length = _dev.readReport (buffer, timeout, &timestamp);
+		if (length == 0)
 			throw Dispatcher::TimeoutError ();
 		try {
-			HIDPP::Report report (std::move (raw_report));
+			HIDPP::Report report (std::span (buffer.data (), length));
+			report.setTimestamp (timestamp);
 			if (report.checkErrorMessage10 (nullptr, nullptr, nullptr)) {
 				return report;
 			}
@@ -117,9 +155,66 @@ Report SimpleDispatcher::getReport (int timeout)
 	}
 }
 
+bool SimpleDispatcher::matchResponse (Report &report)
+{
+	unsigned int function, sw_id;
+	uint8_t sub_id, address, feature, error_code;
+	std::vector<uint8_t> error_data;
+	std::exception_ptr error;
+	if (report.checkErrorMessage10 (&sub_id, &address, &error_code)) {
+		_metrics.increment (DispatcherMetrics::HIDPP10Errors);
+		error = std::make_exception_ptr (HIDPP10::Error (error_code));
+	}
+	else if (report.checkErrorMessage20 (&feature, &function, &sw_id, &error_code, &error_data)) {
+		_metrics.increment (DispatcherMetrics::HIDPP20Errors);
+		sub_id = feature;
+		address = (function & 0x0f) << 4 | (sw_id & 0x0f);
+		error = std::make_exception_ptr (HIDPP20::Error (error_code, std::move (error_data)));
+	}
+	else {
+		sub_id = report.subID ();
+		address = report.address ();
+	}
+	auto it = std::find_if (_pending_commands.begin (), _pending_commands.end (),
+		[&report, sub_id, address] (const CommandResponse *cmd) {
+			return cmd->request.deviceIndex () == report.deviceIndex () &&
+				cmd->request.subID () == sub_id &&
+				cmd->request.address () == address;
+		});
+	if (it == _pending_commands.end ()) {
+		if (error || (report.softwareID () != 0 && report.subID () >= 0x80))
+			_metrics.increment (DispatcherMetrics::UnmatchedAnswers);
+		else // Events may announce a change of the state read by queries.
+			invalidateQueries (report.deviceIndex (), report.subID ());
+		return false;
+	}
+	auto cmd = *it;
+	_metrics.recordRoundTripTime (report.deviceIndex (), sub_id, report.timestamp ().monotonic - cmd->sent);
+	if (error)
+		cmd->error = error;
+	else {
+		_metrics.increment (DispatcherMetrics::ResponsesMatched);
+		cmd->response.emplace (std::move (report));
+	}
+	_pending_commands.erase (it);
+	cmd->pending = false;
+	return true;
+}
+
 SimpleDispatcher::CommandResponse::CommandResponse (SimpleDispatcher *dispatcher, Report &&report):
-	dispatcher (dispatcher), report (std::move (report))
+	dispatcher (dispatcher), request (std::move (report)), pending (true),
+	sent (std::chrono::steady_clock::now ())
 {
+	dispatcher->_pending_commands.push_back (this);
+}
+
+SimpleDispatcher::CommandResponse::~CommandResponse ()
+{
+	if (pending)
+		dispatcher->_pending_commands.erase (std::find (
+				dispatcher->_pending_commands.begin (),
+				dispatcher->_pending_commands.end (),
+				this));
 }
 
 Report SimpleDispatcher::CommandResponse::get ()
@@ -130,34 +225,20 @@ Report SimpleDispatcher::CommandResponse::get ()
 Report SimpleDispatcher::CommandResponse::get (int timeout)
 {
 	auto debug = Log::debug ("dispatcher");
-	while (true) {
-		Report response = dispatcher->getReport (timeout);
-		if (response.deviceIndex () != report.deviceIndex ()) {
-			debug << "Ignored response because of different device index." << std::endl;
-			continue;
-		}
-		unsigned int function, swid;
-		uint8_t sub_id, address, feature, error_code;
-		std::vector<uint8_t> error_data;
-		if (response.checkErrorMessage10 (&sub_id, &address, &error_code)) {
-			if (sub_id == report.subID () && address == report.address ())
-				throw HIDPP10::Error (error_code);
-			else {
-				debug << "Ignored HID++1.0 error response." << std::endl;
-				continue;
-			}
+	while (pending) {
+		try {
+			Report report = dispatcher->getReportOrCountTimeout (timeout);
+			if (!dispatcher->matchResponse (report))
+				debug << "Ignored report while waiting for response." << std::endl;
 		}
-		if (response.checkErrorMessage20 (&feature, &function, &swid, &error_code, &error_data)) {
-			if (feature == report.featureIndex () && function == report.function () && swid == report.softwareID ())
-				throw HIDPP20::Error (error_code, std::move(error_data));
-			else {
-				debug << "Ignored HID++2.0 error response." << std::endl;
-				continue;
-			}
+		catch (Dispatcher::TimeoutError &e) {
+			dispatcher->_metrics.recordCommandTimeout (request.deviceIndex ());
+			throw;
 		}
-		if (report.subID () == response.subID () && report.address () == response.address ())
-			return response;
 	}
+	if (error)
+		std::rethrow_exception (error);
+	return std::move (*response);
 }
 
 SimpleDispatcher::Notification::Notification (SimpleDispatcher *dispatcher, DeviceIndex index, uint8_t sub_id):
@@ -174,7 +255,9 @@ Report SimpleDispatcher::Notification::get (int timeout)
 {
 	auto debug = Log::debug ("dispatcher");
 	while (true) {
-		Report report = dispatcher->getReport (timeout);
+		Report report = dispatcher->getReportOrCountTimeout (timeout);
+		if (dispatcher->matchResponse (report))
+			continue;
 		if (report.deviceIndex () == index && report.subID () == sub_id) {
 			return report;
 		}
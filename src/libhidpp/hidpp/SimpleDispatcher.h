@@ -21,6 +21,7 @@
 
 #include <hidpp/Dispatcher.h>
 #include <hid/RawDevice.h>
+#include <vector>
 
 namespace HIDPP
 {
@@ -36,6 +37,10 @@ namespace HIDPP
  * commands or wait for notifications on the same
  * dispatcher.
  *
+ * Several commands may be sent before getting their responses,
+ * responses received while waiting for another command or notification
+ * are kept until asked for.
+ *
  * TODO: Fix timeout being reset each time a report is received.
  */
 class SimpleDispatcher: public Dispatcher
@@ -46,31 +51,67 @@ public:
 
 	const HID::RawDevice &hidraw () const;
 
+	/**
+	 * \sa HID::RawDevice::setRawTimestamps
+	 */
+	void setRawTimestamps (bool enabled);
+
 	virtual uint16_t vendorID () const;
 	virtual uint16_t productID () const;
 	virtual std::string name () const;
 	virtual void sendCommandWithoutResponse (const Report &report);
 	virtual std::unique_ptr<Dispatcher::AsyncReport> sendCommand (Report &&report);
 	virtual std::unique_ptr<Dispatcher::AsyncReport> getNotification (DeviceIndex index, uint8_t sub_id);
+	/**
+	 * Synchronous, the response is read and \p handler called before
+	 * returning. Unlike the AsyncReport version, it does not allocate.
+	 */
+	virtual void sendCommand (Report &&report, report_handler &&handler, int timeout = -1);
+	using Dispatcher::getNotification;
 
 	void listen ();
 	void stop ();
 
 private:
 	Report getReport (int timeout = -1);
+	/**
+	 * getReport for commands and notifications, timeouts are counted
+	 * in metrics.
+	 */
+	Report getReportOrCountTimeout (int timeout);
 
 	HID::RawDevice _dev;
 
 	class CommandResponse: public Dispatcher::AsyncReport
 	{
 		SimpleDispatcher *dispatcher;
-		Report report;
+		Report request;
+		bool pending;
+		std::chrono::steady_clock::time_point sent;
+		std::optional<Report> response;
+		std::exception_ptr error;
 	public:
 		CommandResponse (SimpleDispatcher *, Report &&);
+		~CommandResponse ();
 		virtual Report get ();
 		virtual Report get (int timeout);
+		friend SimpleDispatcher;
 	};
 	friend CommandResponse;
+	/**
+	 * Pending commands from the oldest to the newest.
+	 *
+	 * Only a few commands are pending at once, a vector keeps its
+	 * capacity and avoids allocating for each command.
+	 */
+	std::vector<CommandResponse *> _pending_commands;
+
+	/**
+	 * Give \p report to the oldest pending command it answers.
+	 *
+	 * \returns false if \p report is not the response to a pending command.
+	 */
+	bool matchResponse (Report &report);
 	class Notification: public Dispatcher::AsyncReport
 	{
 		SimpleDispatcher *dispatcher;
@@ -43,20 +43,44 @@ Device::Device (HIDPP::Device &&device):
 		throw HIDPP::Device::InvalidProtocolVersion (version);
 }
 
-template<uint8_t sub_id, HIDPP::Report::Type request_type, HIDPP::Report::Type result_type>
-void Device::accessRegister (uint8_t address,
+Device::RegisterAccess Device::setRegisterAccess (std::size_t size)
+{
+	if (size <= HIDPP::ShortParamLength)
+		return { SetRegisterShort, HIDPP::Report::Short, HIDPP::Report::Short };
+	else if (size <= HIDPP::LongParamLength)
+		return { SetRegisterLong, HIDPP::Report::Long, HIDPP::Report::Short };
+	else
+		throw std::logic_error ("Register too long");
+}
+
+Device::RegisterAccess Device::getRegisterAccess (std::size_t size)
+{
+	if (size <= HIDPP::ShortParamLength)
+		return { GetRegisterShort, HIDPP::Report::Short, HIDPP::Report::Short };
+	else if (size <= HIDPP::LongParamLength)
+		return { GetRegisterLong, HIDPP::Report::Short, HIDPP::Report::Long };
+	else
+		throw std::logic_error ("Register too long");
+}
+
+void Device::accessRegister (const RegisterAccess &access,
+			     uint8_t address,
 			     const std::vector<uint8_t> *params,
-			     std::vector<uint8_t> *results)
+			     std::vector<uint8_t> *results,
+			     bool adaptive_timeout)
 {
-	HIDPP::Report request (request_type, deviceIndex (), sub_id, address);
+	HIDPP::Report request (access.request_type, deviceIndex (), access.sub_id, address);
 	if (params) {
 		assert (params->size () <= request.parameterLength ());
 		std::copy (params->begin (), params->end (), request.parameterBegin ());
 	}
 
-	auto response = dispatcher ()->sendCommand (std::move (request))->get ();
+	auto command = dispatcher ()->sendCommand (std::move (request));
+	auto response = adaptive_timeout
+		? command->get (dispatcher ()->commandTimeout (deviceIndex ()))
+		: command->get ();
 
-	if (response.type () != result_type)
+	if (response.type () != access.result_type)
 		throw std::runtime_error ("Invalid result length");
 
 	if (results)
@@ -65,65 +89,38 @@ void Device::accessRegister (uint8_t address,
 
 void Device::setRegister (uint8_t address,
 			  const std::vector<uint8_t> &params,
-			  std::vector<uint8_t> *results)
+			  std::vector<uint8_t> *results,
+			  bool adaptive_timeout)
 {
 	auto debug = Log::debug ("register");
-	if (params.size () <= HIDPP::ShortParamLength) {
-		debug.printf ("Setting short register 0x%02hhx\n", address);
-		debug.printBytes ("Parameters:", params.begin (), params.end ());
-
-		accessRegister<SetRegisterShort,
-			       HIDPP::Report::Short, HIDPP::Report::Short>
-			      (address, &params, results);
-
-		if (results)
-			debug.printBytes ("Results:", results->begin (), results->end ());
-	}
-	else if (params.size () <= HIDPP::LongParamLength) {
-		debug.printf ("Setting long register 0x%02hhx\n", address);
-		debug.printBytes ("Parameters:", params.begin (), params.end ());
-
-		accessRegister<SetRegisterLong,
-			       HIDPP::Report::Long, HIDPP::Report::Short>
-			      (address, &params, results);
+	auto access = setRegisterAccess (params.size ());
+	debug.printf ("Setting %s register 0x%02hhx\n",
+		      access.request_type == HIDPP::Report::Short ? "short" : "long",
+		      address);
+	debug.printBytes ("Parameters:", params.begin (), params.end ());
 
-		if (results)
-			debug.printBytes ("Results:", results->begin (), results->end ());
-	}
-	else
-		throw std::logic_error ("Register too long");
+	accessRegister (access, address, &params, results, adaptive_timeout);
 
+	if (results)
+		debug.printBytes ("Results:", results->begin (), results->end ());
 }
 
 void Device::getRegister (uint8_t address,
 			  const std::vector<uint8_t> *params,
-			  std::vector<uint8_t> &results)
+			  std::vector<uint8_t> &results,
+			  bool adaptive_timeout)
 {
 	auto debug = Log::debug ("register");
-	if (results.size () <= HIDPP::ShortParamLength) {
-		debug.printf ("Getting short register 0x%02hhx\n", address);
-		if (params)
-			debug.printBytes ("Parameters:", params->begin (), params->end ());
+	auto access = getRegisterAccess (results.size ());
+	debug.printf ("Getting %s register 0x%02hhx\n",
+		      access.result_type == HIDPP::Report::Short ? "short" : "long",
+		      address);
+	if (params)
+		debug.printBytes ("Parameters:", params->begin (), params->end ());
 
-		accessRegister<GetRegisterShort,
-			       HIDPP::Report::Short, HIDPP::Report::Short>
-			      (address, params, &results);
+	accessRegister (access, address, params, &results, adaptive_timeout);
 
-		debug.printBytes ("Results:", results.begin (), results.end ());
-	}
-	else if (results.size () <= HIDPP::LongParamLength) {
-		debug.printf ("Getting long register 0x%02hhx\n", address);
-		if (params)
-			debug.printBytes ("Parameters:", params->begin (), params->end ());
-
-		accessRegister<GetRegisterLong,
-			       HIDPP::Report::Short, HIDPP::Report::Long>
-			      (address, params, &results);
-
-		debug.printBytes ("Results:", results.begin (), results.end ());
-	}
-	else
-		throw std::logic_error ("Register too long");
+	debug.printBytes ("Results:", results.begin (), results.end ());
 }
 
 void Device::sendDataPacket (uint8_t sub_id, uint8_t seq_num,
@@ -33,22 +33,50 @@ public:
 	Device (HIDPP::Dispatcher *dispatcher, HIDPP::DeviceIndex device_index = HIDPP::DefaultDevice);
 	Device (HIDPP::Device &&device);
 
+	/**
+	 * Sub ID and report types of a register access.
+	 */
+	struct RegisterAccess
+	{
+		uint8_t sub_id;
+		HIDPP::Report::Type request_type;
+		HIDPP::Report::Type result_type;
+	};
+
+	/**
+	 * Select the short or long access for writing \p size parameter
+	 * bytes, or reading \p size result bytes.
+	 *
+	 * \throws std::logic_error if the register is too long.
+	 */
+	static RegisterAccess setRegisterAccess (std::size_t size);
+	static RegisterAccess getRegisterAccess (std::size_t size);
+
+	/**
+	 * Register accesses time out after Dispatcher::commandTimeout
+	 * unless \p adaptive_timeout is false, operations that may take
+	 * long (e.g. writing flash memory) wait for the answer without
+	 * timeout.
+	 */
 	void setRegister (uint8_t address,
 			  const std::vector<uint8_t> &params,
-			  std::vector<uint8_t> *results);
+			  std::vector<uint8_t> *results,
+			  bool adaptive_timeout = true);
 	void getRegister (uint8_t address,
 			  const std::vector<uint8_t> *params,
-			  std::vector<uint8_t> &results);
+			  std::vector<uint8_t> &results,
+			  bool adaptive_timeout = true);
 
 	void sendDataPacket (uint8_t sub_id, uint8_t seq_num,
 			     std::vector<uint8_t>::const_iterator param_begin,
 			     std::vector<uint8_t>::const_iterator param_end,
 			     bool wait_for_ack = false);
 private:
-	template<uint8_t sub_id, HIDPP::Report::Type request_type, HIDPP::Report::Type result_type>
-	void accessRegister (uint8_t address,
+	void accessRegister (const RegisterAccess &access,
+			     uint8_t address,
 			     const std::vector<uint8_t> *params,
-			     std::vector<uint8_t> *results);
+			     std::vector<uint8_t> *results,
+			     bool adaptive_timeout);
 };
 
 }
@@ -123,7 +123,7 @@ void IMemory::resetSequenceNumber ()
 {
 	std::vector<uint8_t> params (ShortParamLength);
 	params[0] = 1;
-	_dev->setRegister (ResetSeqNum, params, nullptr);
+	_dev->setRegister (ResetSeqNum, params, nullptr, false);
 }
 
 void IMemory::fillPage (uint8_t page)
@@ -131,6 +131,7 @@ void IMemory::fillPage (uint8_t page)
 	std::vector<uint8_t> params (LongParamLength);
 	params[0] = Fill;
 	params[6] = page;
-	_dev->setRegister (MemoryOperation, params, nullptr);
+	// Filling or erasing flash memory may take long.
+	_dev->setRegister (MemoryOperation, params, nullptr, false);
 }
 
@@ -112,6 +112,11 @@ std::size_t MacroFormat::getLength (const Macro::Item &item) const
 	return getOpLength (it->second);
 }
 
+std::size_t MacroFormat::getMaxLength () const
+{
+	return getOpLength (0x60);
+}
+
 void MacroFormat::writeAddress (std::vector<uint8_t>::iterator it, const Address &addr) const
 {
 	it[0] = addr.page;
@@ -30,6 +30,7 @@ class MacroFormat: public HIDPP::AbstractMacroFormat
 {
 public:
 	virtual std::size_t getLength (const HIDPP::Macro::Item &item) const;
+	virtual std::size_t getMaxLength () const;
 
 	virtual void writeAddress (std::vector<uint8_t>::iterator it,
 				   const HIDPP::Address &addr) const;
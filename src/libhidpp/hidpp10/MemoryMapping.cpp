@@ -18,6 +18,7 @@
 
 #include "MemoryMapping.h"
 
+#include <hidpp/Report.h>
 #include <hidpp10/defs.h>
 #include <misc/Log.h>
 
@@ -45,7 +46,7 @@ std::vector<uint8_t>::iterator MemoryMapping::getWritableIterator (const Address
 
 bool MemoryMapping::computeOffset (std::vector<uint8_t>::const_iterator it, Address &address)
 {
-	auto &page = getReadOnlyPage (address);
+	auto &page = getPartialPage (address, 0, 0);
 	int dist = distance (page.begin (), it);
 	if (dist % 2 == 1)
 		return false;
@@ -59,6 +60,32 @@ void MemoryMapping::readPage (const Address &address, std::vector<uint8_t> &data
 	_imem.readMem (address, data);
 }
 
+std::size_t MemoryMapping::lineSize () const
+{
+	// One MemoryRead register read
+	return LongParamLength;
+}
+
+std::size_t MemoryMapping::pageSize (const Address &) const
+{
+	return PageSize;
+}
+
+std::size_t MemoryMapping::byteOffset (const Address &address) const
+{
+	// HID++1.0 offsets count 16 bits words
+	return address.offset*2;
+}
+
+void MemoryMapping::readLines (const Address &address, std::size_t begin, std::size_t end, std::vector<uint8_t> &data)
+{
+	Address current = address;
+	while (begin < end) {
+		current.offset = begin/2;
+		begin += _imem.readSome (current, &data[begin], end - begin);
+	}
+}
+
 void MemoryMapping::writePage (const Address &address, const std::vector<uint8_t> &data)
 {
 	_imem.writePage (address.page, data);
@@ -31,6 +31,7 @@ class MemoryMapping: public HIDPP::AbstractMemoryMapping
 public:
 	MemoryMapping (Device *dev, bool write_crc = true);
 
+	using AbstractMemoryMapping::getReadOnlyIterator;
 	virtual std::vector<uint8_t>::const_iterator getReadOnlyIterator (const HIDPP::Address &address);
 	virtual std::vector<uint8_t>::iterator getWritableIterator (const HIDPP::Address &address);
 	virtual bool computeOffset (std::vector<uint8_t>::const_iterator it, HIDPP::Address &address);
@@ -38,6 +39,10 @@ public:
 protected:
 	virtual void readPage (const HIDPP::Address &address, std::vector<uint8_t> &data);
 	virtual void writePage (const HIDPP::Address &address, const std::vector<uint8_t> &data);
+	virtual std::size_t lineSize () const;
+	virtual std::size_t pageSize (const HIDPP::Address &address) const;
+	virtual std::size_t byteOffset (const HIDPP::Address &address) const;
+	virtual void readLines (const HIDPP::Address &address, std::size_t begin, std::size_t end, std::vector<uint8_t> &data);
 
 private:
 	IMemory _imem;
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <hidpp10/PairingCache.h>
+
+#include <hidpp10/defs.h>
+#include <hidpp10/Error.h>
+#include <hidpp10/IReceiver.h>
+#include <misc/Log.h>
+
+#include <stdexcept>
+
+using namespace HIDPP10;
+
+PairingCache::PairingCache (HIDPP::Dispatcher *dispatcher):
+	_dispatcher (dispatcher)
+{
+	for (unsigned int i = 0; i < SlotCount; ++i) {
+		auto index = static_cast<HIDPP::DeviceIndex> (HIDPP::WirelessDevice1 + i);
+		for (uint8_t sub_id: { DeviceDisconnection, DeviceConnection })
+			_listeners.push_back (_dispatcher->registerEventHandler (index, sub_id,
+				[this, i] (const HIDPP::Report &) {
+					invalidate (i);
+					return true;
+				}));
+	}
+}
+
+PairingCache::~PairingCache ()
+{
+	for (auto it: _listeners)
+		_dispatcher->unregisterEventHandler (it);
+}
+
+PairingCache::Entry PairingCache::get (HIDPP::DeviceIndex index)
+{
+	if (index < HIDPP::WirelessDevice1 || index > HIDPP::WirelessDevice6)
+		throw std::out_of_range ("Not a wireless device index");
+	unsigned int slot = index - HIDPP::WirelessDevice1;
+	std::optional<Slot> s;
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		if (_slots[slot].state != State::Unknown)
+			s = _slots[slot];
+	}
+	if (!s)
+		s = fill (slot);
+	if (s->state == State::Unpaired)
+		throw Error (Error::UnknownDevice);
+	return s->entry;
+}
+
+void PairingCache::invalidate ()
+{
+	for (unsigned int i = 0; i < SlotCount; ++i)
+		invalidate (i);
+}
+
+void PairingCache::invalidate (unsigned int slot)
+{
+	std::unique_lock<std::mutex> lock (_mutex);
+	Log::debug ("pairing").printf ("Forget pairing information for device %u\n", slot+1);
+	_slots[slot].state = State::Unknown;
+	++_slots[slot].generation;
+}
+
+PairingCache::Slot PairingCache::fill (unsigned int slot)
+{
+	std::unique_lock<std::mutex> fill_lock (_fill_mutex);
+	std::array<std::optional<Slot>, SlotCount> slots; // slots to read
+	{
+		std::unique_lock<std::mutex> lock (_mutex);
+		if (_slots[slot].state != State::Unknown)
+			return _slots[slot]; // read by a concurrent call
+		for (unsigned int i = 0; i < SlotCount; ++i)
+			if (_slots[i].state == State::Unknown)
+				slots[i] = _slots[i];
+	}
+
+	if (!_receiver)
+		_receiver.emplace (_dispatcher, HIDPP::DefaultDevice);
+	IReceiver ireceiver (&*_receiver);
+	for (unsigned int i = 0; i < SlotCount; ++i) {
+		if (!slots[i])
+			continue;
+		try {
+			ireceiver.getDeviceInformation (i, nullptr, nullptr, &slots[i]->entry.wpid, nullptr);
+			slots[i]->entry.name = ireceiver.getDeviceName (i);
+			slots[i]->state = State::Paired;
+		}
+		catch (Error &e) {
+			// the invalid value is the device index
+			if (e.errorCode () != Error::InvalidValue)
+				throw;
+			slots[i]->state = State::Unpaired;
+		}
+		Log::debug ("pairing").printf ("Device %u is %s\n", i+1,
+				slots[i]->state == State::Paired ? slots[i]->entry.name.c_str () : "not paired");
+	}
+
+	std::unique_lock<std::mutex> lock (_mutex);
+	for (unsigned int i = 0; i < SlotCount; ++i) {
+		// Keep the slot unknown if a notification invalidated it while reading.
+		if (slots[i] && slots[i]->generation == _slots[i].generation)
+			_slots[i] = *slots[i];
+	}
+	return *slots[slot];
+}
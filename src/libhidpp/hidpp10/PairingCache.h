@@ -0,0 +1,102 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP10_PAIRING_CACHE_H
+#define LIBHIDPP_HIDPP10_PAIRING_CACHE_H
+
+#include <hidpp/Dispatcher.h>
+#include <hidpp10/Device.h>
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace HIDPP10
+{
+
+/**
+ * Pairing information of the wireless devices of a receiver.
+ *
+ * The information of all unknown slots is read from the receiver in a
+ * single batch the first time it is needed. A slot is forgotten when the
+ * receiver sends a connection or disconnection notification for it, and
+ * read again on the next access.
+ *
+ * Each dispatcher owns one cache (see HIDPP::Dispatcher::pairingCache).
+ * Notifications are only seen while the dispatcher is processing reports.
+ *
+ * This class is thread-safe.
+ */
+class PairingCache
+{
+public:
+	struct Entry
+	{
+		uint16_t wpid;		///< Wireless product ID.
+		std::string name;
+	};
+
+	PairingCache (HIDPP::Dispatcher *dispatcher);
+	~PairingCache ();
+
+	/**
+	 * Get the pairing information for the wireless device \p index.
+	 *
+	 * \throws Error with Error::UnknownDevice if nothing is paired with \p index.
+	 */
+	Entry get (HIDPP::DeviceIndex index);
+
+	/**
+	 * Forget the information about every slot.
+	 */
+	void invalidate ();
+
+private:
+	static constexpr unsigned int SlotCount = 6;
+
+	enum class State {
+		Unknown,
+		Unpaired,
+		Paired,
+	};
+	struct Slot
+	{
+		State state = State::Unknown;
+		unsigned int generation = 0; // incremented by each invalidation
+		Entry entry;
+	};
+
+	void invalidate (unsigned int slot);
+	/**
+	 * Read all unknown slots from the receiver and return \p slot.
+	 */
+	Slot fill (unsigned int slot);
+
+	HIDPP::Dispatcher *_dispatcher;
+	std::vector<HIDPP::Dispatcher::listener_iterator> _listeners;
+	std::mutex _fill_mutex; // serialize receiver requests, protects _receiver
+	std::optional<Device> _receiver;
+	std::mutex _mutex; // protects _slots, never held while waiting for the receiver
+	std::array<Slot, SlotCount> _slots;
+};
+
+}
+
+#endif
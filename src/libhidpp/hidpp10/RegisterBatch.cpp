@@ -0,0 +1,153 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "RegisterBatch.h"
+
+#include <hidpp10/Device.h>
+#include <hidpp10/Error.h>
+#include <misc/Log.h>
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <set>
+#include <stdexcept>
+
+using namespace HIDPP10;
+
+RegisterBatch::RegisterBatch (Device *dev, unsigned int window):
+	_dev (dev), _window (std::max (window, 1u))
+{
+}
+
+RegisterBatch::~RegisterBatch ()
+{
+}
+
+void RegisterBatch::getRegister (uint8_t address, std::size_t size,
+				 const std::vector<uint8_t> *params,
+				 completion &&done)
+{
+	auto access = Device::getRegisterAccess (size);
+	HIDPP::Report request (access.request_type, _dev->deviceIndex (), access.sub_id, address);
+	if (params) {
+		assert (params->size () <= request.parameterLength ());
+		std::copy (params->begin (), params->end (), request.parameterBegin ());
+	}
+	_queue.push_back ({ std::move (request), access.result_type, std::move (done), 0 });
+}
+
+void RegisterBatch::setRegister (uint8_t address, const std::vector<uint8_t> &params,
+				 completion &&done)
+{
+	auto access = Device::setRegisterAccess (params.size ());
+	HIDPP::Report request (access.request_type, _dev->deviceIndex (), access.sub_id, address);
+	std::copy (params.begin (), params.end (), request.parameterBegin ());
+	_queue.push_back ({ std::move (request), access.result_type, std::move (done), 0 });
+}
+
+std::size_t RegisterBatch::size () const
+{
+	return _queue.size () + _in_flight.size ();
+}
+
+uint16_t RegisterBatch::key (const HIDPP::Report &request)
+{
+	return request.subID () << 8 | request.address ();
+}
+
+void RegisterBatch::sendReady ()
+{
+	auto debug = Log::debug ("register");
+	std::set<uint16_t> busy;
+	for (const auto &access: _in_flight)
+		busy.insert (access.key);
+	auto it = _queue.begin ();
+	while (it != _queue.end () && _in_flight.size () < _window) {
+		auto k = key (it->request);
+		if (!busy.insert (k).second) {
+			// Keep queue order for the same register, an access
+			// waiting for this key also blocks later ones.
+			++it;
+			continue;
+		}
+		debug.printf ("Sending register request 0x%02hhx for 0x%02hhx\n",
+			      it->request.subID (), it->request.address ());
+		debug.printBytes ("Parameters:", it->request.parameterBegin (), it->request.parameterEnd ());
+		std::unique_ptr<HIDPP::Dispatcher::AsyncReport> response;
+		try {
+			response = _dev->dispatcher ()->sendCommand (HIDPP::Report (it->request));
+		}
+		catch (...) {
+			// e.g. the device refused the report, only this access fails.
+			auto done = std::move (it->done);
+			it = _queue.erase (it);
+			if (done)
+				done (nullptr, std::current_exception ());
+			return;
+		}
+		_in_flight.push_back ({ k, std::move (*it), std::move (response) });
+		it = _queue.erase (it);
+	}
+}
+
+void RegisterBatch::run ()
+{
+	auto debug = Log::debug ("register");
+	auto dispatcher = _dev->dispatcher ();
+	while (!_queue.empty () || !_in_flight.empty ()) {
+		sendReady ();
+		if (_in_flight.empty ())
+			continue;
+		// HID++1.0 devices answer in order, waiting for the oldest
+		// request first does not delay the completion of others.
+		InFlight in_flight = std::move (_in_flight.front ());
+		_in_flight.pop_front ();
+		auto &access = in_flight.access;
+		std::optional<std::vector<uint8_t>> results;
+		std::exception_ptr error;
+		try {
+			auto response = in_flight.response->get (dispatcher->commandTimeout (_dev->deviceIndex ()));
+			if (response.type () != access.result_type)
+				throw std::runtime_error ("Invalid result length");
+			results.emplace (response.parameterBegin (), response.parameterEnd ());
+			debug.printf ("Register request 0x%02hhx for 0x%02hhx completed\n",
+				      in_flight.key >> 8, in_flight.key & 0xff);
+			debug.printBytes ("Results:", results->begin (), results->end ());
+		}
+		catch (Error &e) {
+			if (e.errorCode () == Error::Busy && access.busy_retries < MaxBusyRetries) {
+				// Too many requests for the device, send this one
+				// again (before later accesses to the same
+				// register) with fewer requests in flight.
+				++access.busy_retries;
+				_window = std::max (_window / 2, 1u);
+				debug.printf ("Register request 0x%02hhx for 0x%02hhx busy, window is now %u\n",
+					      in_flight.key >> 8, in_flight.key & 0xff, _window);
+				_queue.push_front (std::move (access));
+				continue;
+			}
+			error = std::current_exception ();
+		}
+		catch (...) {
+			error = std::current_exception ();
+		}
+		if (access.done)
+			access.done (results ? &*results : nullptr, error);
+	}
+}
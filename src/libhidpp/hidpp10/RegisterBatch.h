@@ -0,0 +1,137 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP10_REGISTER_BATCH_H
+#define LIBHIDPP_HIDPP10_REGISTER_BATCH_H
+
+#include <hidpp/Dispatcher.h>
+#include <hidpp/Report.h>
+
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace HIDPP10
+{
+
+class Device;
+
+/**
+ * Pipelined HID++1.0 register accesses.
+ *
+ * Register reads and writes are queued, then run() sends them and calls
+ * their completion as their answers arrive. HID++1.0 answers are only
+ * matched by sub ID and address, so several accesses are in flight at
+ * once only if they use distinct (sub ID, address) pairs. Accesses to the
+ * same register are sent in queue order, each one after the answer to the
+ * previous one.
+ *
+ * When the device answers HIDPP10::Error::Busy, the access is queued
+ * again and the window is halved, it only completes with the error after
+ * MaxBusyRetries attempts.
+ *
+ * \code
+ * HIDPP10::RegisterBatch batch (&dev);
+ * for (unsigned int address = 0; address < 256; ++address)
+ *	batch.getRegister (address, HIDPP::ShortParamLength, nullptr,
+ *		[] (const std::vector<uint8_t> *results, std::exception_ptr error) { ... });
+ * batch.run ();
+ * \endcode
+ */
+class RegisterBatch
+{
+public:
+	/**
+	 * Called with the results of the access, or with the error
+	 * (HIDPP10::Error, HIDPP::Dispatcher::TimeoutError, ...) and null
+	 * results.
+	 */
+	typedef std::function<void (const std::vector<uint8_t> *results, std::exception_ptr error)> completion;
+
+	/**
+	 * Default maximum number of accesses in flight.
+	 */
+	static constexpr unsigned int DefaultWindow = 8;
+
+	/**
+	 * Number of times an access is sent again after a busy error.
+	 */
+	static constexpr unsigned int MaxBusyRetries = 4;
+
+	RegisterBatch (Device *dev, unsigned int window = DefaultWindow);
+	~RegisterBatch ();
+
+	/**
+	 * Queue a register read, \p size is HIDPP::ShortParamLength or
+	 * HIDPP::LongParamLength.
+	 */
+	void getRegister (uint8_t address, std::size_t size,
+			  const std::vector<uint8_t> *params,
+			  completion &&done);
+
+	/**
+	 * Queue a register write, its size is given by \p params.
+	 */
+	void setRegister (uint8_t address, const std::vector<uint8_t> &params,
+			  completion &&done);
+
+	/**
+	 * Number of queued accesses not completed yet.
+	 */
+	std::size_t size () const;
+
+	/**
+	 * Send the queued accesses and wait for all of them to complete.
+	 *
+	 * Completions are called from this thread and may queue new
+	 * accesses, they are sent by the same run. If a completion throws,
+	 * the exception is propagated and the remaining accesses stay
+	 * queued (those in flight are cancelled).
+	 */
+	void run ();
+
+private:
+	struct Access
+	{
+		HIDPP::Report request;
+		HIDPP::Report::Type result_type;
+		completion done;
+		unsigned int busy_retries;
+	};
+	struct InFlight
+	{
+		uint16_t key;
+		Access access;
+		std::unique_ptr<HIDPP::Dispatcher::AsyncReport> response;
+	};
+
+	static uint16_t key (const HIDPP::Report &request);
+	void sendReady ();
+
+	Device *_dev;
+	unsigned int _window;
+	std::deque<Access> _queue;
+	std::deque<InFlight> _in_flight;
+};
+
+}
+
+#endif
@@ -19,14 +19,28 @@
 #include "Device.h"
 
 #include <hidpp/Dispatcher.h>
+#include <hidpp20/IFeatureSet.h>
+#include <hidpp20/IRoot.h>
 #include <misc/Log.h>
+#include <misc/PersistentCache.h>
 
-using namespace HIDPP20;
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
 
-unsigned int Device::softwareID = 1;
+using namespace HIDPP20;
 
 Device::Device (HIDPP::Dispatcher *dispatcher, HIDPP::DeviceIndex device_index):
-	HIDPP::Device (dispatcher, device_index)
+	HIDPP::Device (dispatcher, device_index),
+	_feature_cache_loaded (false),
+	_feature_cache_dirty (false),
+	_query_max_age (std::chrono::milliseconds::zero ())
 {
 	auto version = protocolVersion ();
 	if (std::get<0> (version) < 2)
@@ -34,31 +48,324 @@ Device::Device (HIDPP::Dispatcher *dispatcher, HIDPP::DeviceIndex device_index):
 }
 
 Device::Device (HIDPP::Device &&device):
-	HIDPP::Device (std::move (device))
+	HIDPP::Device (std::move (device)),
+	_feature_cache_loaded (false),
+	_feature_cache_dirty (false),
+	_query_max_age (std::chrono::milliseconds::zero ())
 {
 	auto version = protocolVersion ();
 	if (std::get<0> (version) < 2)
 		throw HIDPP::Device::InvalidProtocolVersion (version);
 }
 
+Device::~Device ()
+{
+	if (!_feature_cache_dirty)
+		return;
+	try {
+		saveFeatureCache ();
+	}
+	catch (std::exception &e) {
+		Log::warning ("feature") << "Failed to save feature cache: " << e.what () << std::endl;
+	}
+}
+
 std::vector<uint8_t> Device::callFunction (uint8_t feature_index,
 					   unsigned int function,
 					   std::vector<uint8_t>::const_iterator param_begin,
 					   std::vector<uint8_t>::const_iterator param_end)
 {
-	auto debug = Log::debug ("call");
-	debug.printf ("Calling feature 0x%02hhx/function %u\n", feature_index, function);
-	debug.printBytes ("Parameters:", param_begin, param_end);
+	std::array<uint8_t, HIDPP::VeryLongParamLength> results;
+	auto length = callFunction (feature_index, function,
+				    std::span<const uint8_t> (param_begin, param_end),
+				    results);
+	return std::vector<uint8_t> (results.begin (), results.begin () + length);
+}
 
-	std::size_t len = std::distance (param_begin, param_end);
-	auto type = dispatcher ()->reportInfo ().findReport (len);
+std::size_t Device::callFunction (uint8_t feature_index,
+				  unsigned int function,
+				  std::span<const uint8_t> params,
+				  std::span<uint8_t> results)
+{
+	auto request = makeRequest (feature_index, function, params.size ());
+	std::copy (params.begin (), params.end (), request.parameterBegin ());
+	auto response = sendRequest (std::move (request));
+	auto length = std::min (response.parameterLength (), results.size ());
+	auto end = std::copy_n (response.parameterBegin (), length, results.begin ());
+	std::fill (end, results.end (), 0);
+	return length;
+}
+
+std::unique_ptr<HIDPP::Dispatcher::AsyncReport> Device::callFunctionAsync (
+		uint8_t feature_index,
+		unsigned int function,
+		std::vector<uint8_t>::const_iterator param_begin,
+		std::vector<uint8_t>::const_iterator param_end)
+{
+	auto request = makeRequest (feature_index, function, std::distance (param_begin, param_end));
+	std::copy (param_begin, param_end, request.parameterBegin ());
+	logRequest (request);
+	dispatcher ()->invalidateQueries (deviceIndex (), feature_index);
+	return dispatcher ()->sendCommand (std::move (request));
+}
+
+HIDPP::Report Device::makeRequest (uint8_t feature_index,
+				   unsigned int function,
+				   std::size_t param_length)
+{
+	auto type = dispatcher ()->reportInfo ().findReport (param_length);
 	if (!type)
 		throw std::logic_error ("Parameters too long");
-	HIDPP::Report request (*type, deviceIndex (), feature_index, function, softwareID);
-	std::copy (param_begin, param_end, request.parameterBegin ());
+	auto sw_id = dispatcher ()->nextSoftwareID (deviceIndex (), feature_index);
+	return HIDPP::Report (*type, deviceIndex (), feature_index, function, sw_id);
+}
+
+std::size_t Device::queryFunction (uint8_t feature_index,
+				   unsigned int function,
+				   std::span<const uint8_t> params,
+				   std::span<uint8_t> results)
+{
+	auto request = makeRequest (feature_index, function, params.size ());
+	std::copy (params.begin (), params.end (), request.parameterBegin ());
+	auto response = sendQuery (std::move (request));
+	auto length = std::min (response.parameterLength (), results.size ());
+	auto end = std::copy_n (response.parameterBegin (), length, results.begin ());
+	std::fill (end, results.end (), 0);
+	return length;
+}
+
+HIDPP::Report Device::sendRequest (HIDPP::Report &&request)
+{
+	// The request may change what queries to this feature return.
+	dispatcher ()->invalidateQueries (deviceIndex (), request.subID ());
+	return waitResponse (std::move (request), false);
+}
+
+HIDPP::Report Device::sendQuery (HIDPP::Report &&request)
+{
+	return waitResponse (std::move (request), true);
+}
+
+std::chrono::milliseconds Device::queryMaxAge () const
+{
+	return _query_max_age;
+}
+
+void Device::setQueryMaxAge (std::chrono::milliseconds max_age)
+{
+	_query_max_age = max_age;
+}
+
+HIDPP::Report Device::waitResponse (HIDPP::Report &&request, bool query)
+{
+	struct {
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool done = false;
+		std::optional<HIDPP::Report> response;
+		std::exception_ptr error;
+	} call;
+	logRequest (request);
+	auto handler = [&call] (const HIDPP::Report *report, std::exception_ptr error) {
+		std::unique_lock<std::mutex> lock (call.mutex);
+		if (report)
+			call.response.emplace (*report);
+		else
+			call.error = error;
+		call.done = true;
+		// notify while locked: call is destroyed as soon as the caller wakes up
+		call.cond.notify_one ();
+	};
+	if (query)
+		dispatcher ()->sendQuery (std::move (request), std::move (handler), _query_max_age);
+	else
+		dispatcher ()->sendCommand (std::move (request), std::move (handler));
+	std::unique_lock<std::mutex> lock (call.mutex);
+	call.cond.wait (lock, [&call] () { return call.done; });
+	if (call.error)
+		std::rethrow_exception (call.error);
+
+	auto results = call.response->parameters ();
+	Log::debug ("call").printBytes ("Results:", results.begin (), results.end ());
+	return std::move (*call.response);
+}
 
-	auto response = dispatcher ()->sendCommand (std::move (request))->get ();
+void Device::logRequest (const HIDPP::Report &request)
+{
+	auto debug = Log::debug ("call");
+	if (!debug)
+		return;
+	debug.printf ("Calling feature 0x%02hhx/function %u (software ID %u)\n",
+		      request.featureIndex (), request.function (), request.softwareID ());
+	auto params = request.parameters ();
+	debug.printBytes ("Parameters:", params.begin (), params.end ());
+}
+
+uint8_t Device::getFeatureIndex (uint16_t feature_id)
+{
+	auto it = _features.find (feature_id);
+	if (it != _features.end ())
+		return it->second;
+	if (!_feature_cache_loaded)
+		loadFeatureCache ();
+	auto cached = _cached_features.find (feature_id);
+	if (cached != _cached_features.end ())
+		return cached->second;
+	if (_feature_table)
+		return _feature_table->index (feature_id);
+	uint8_t index = IRoot (this).getFeature (feature_id);
+	_features.emplace (feature_id, index);
+	// The cache file is written once, when this object is destroyed.
+	_feature_cache_dirty = true;
+	return index;
+}
 
-	debug.printBytes ("Results:", response.parameterBegin (), response.parameterEnd ());
-	return std::vector<uint8_t> (response.parameterBegin (), response.parameterEnd ());
+std::shared_ptr<const FeatureTable> Device::enumerateFeatures ()
+{
+	if (_feature_table)
+		return _feature_table;
+
+	IFeatureSet ifeatureset (this);
+	unsigned int count = ifeatureset.getCount ();
+	std::vector<FeatureTable::Feature> features (count+1);
+	features[0] = { IRoot::ID, false, false, false, 0 };
+
+	std::deque<std::pair<unsigned int, std::unique_ptr<HIDPP::Dispatcher::AsyncReport>>> pending;
+	unsigned int next = 1;
+	while (next <= count || !pending.empty ()) {
+		while (next <= count && pending.size () < HIDPP::Dispatcher::SoftwareIDCount) {
+			auto request = makeRequest (ifeatureset.index (), IFeatureSet::GetFeatureID,
+						    IFeatureSet::GetFeatureIDFunction::Params::size);
+			IFeatureSet::GetFeatureIDFunction::Params::encode (request.parameterBegin (),
+									   static_cast<uint8_t> (next));
+			logRequest (request);
+			pending.emplace_back (next, dispatcher ()->sendCommand (std::move (request)));
+			++next;
+		}
+		auto &[index, response] = pending.front ();
+		auto report = response->get ();
+		auto [id, obsolete, hidden, internal, version] =
+			IFeatureSet::GetFeatureIDFunction::Results::decode (report.parameterBegin ());
+		features[index] = { id, obsolete, hidden, internal, version };
+		pending.pop_front ();
+	}
+
+	_feature_table = std::make_shared<FeatureTable> (std::move (features));
+	// The table comes from the device, it supersedes any cached index.
+	_cached_features.clear ();
+	for (unsigned int i = 1; i <= count; ++i)
+		_features[(*_feature_table)[i].id] = i;
+	_feature_count = count;
+	saveFeatureCache ();
+	return _feature_table;
+}
+
+void Device::invalidateFeatureCache ()
+{
+	if (_cached_features.empty ())
+		return;
+	Log::info ("feature") << "Discarding cached feature indices." << std::endl;
+	_cached_features.clear ();
+	_feature_cache_dirty = true;
+}
+
+/*
+ * Feature cache files contain a header identifying the device followed by
+ * one line per feature:
+ *
+ *     hidpp20-features 2
+ *     device <protocol major> <protocol minor> <name>
+ *     count <feature count>
+ *     <feature id> <feature index>
+ *
+ * The feature count is the one given by IFeatureSet (0 if it is not
+ * supported). Ids, indices and count are hexadecimal.
+ */
+static constexpr const char *FeatureCacheHeader = "hidpp20-features 2";
+
+std::string Device::featureCachePath () const
+{
+	char name[32];
+	snprintf (name, sizeof (name), "hidpp20-features-%04hx-%04hx",
+		  dispatcher ()->vendorID (), productID ());
+	return PersistentCache::path (name);
+}
+
+unsigned int Device::readFeatureCount ()
+{
+	uint8_t index = IRoot (this).getFeature (IFeatureSet::ID);
+	_features.emplace (IFeatureSet::ID, index);
+	if (index == 0)
+		return 0;
+	auto [count] = call<IFeatureSet::GetCountFunction> (index);
+	return count;
+}
+
+void Device::loadFeatureCache ()
+{
+	_feature_cache_loaded = true;
+	auto path = featureCachePath ();
+	if (path.empty ())
+		return;
+	// The feature count is needed for saving the cache, and for checking
+	// the file (e.g. the firmware may have been updated since).
+	if (!_feature_count)
+		_feature_count = readFeatureCount ();
+	std::ifstream file (path);
+	if (!file)
+		return;
+	std::string header, device, count_line;
+	std::getline (file, header);
+	std::getline (file, device);
+	std::getline (file, count_line);
+	auto [major, minor] = protocolVersion ();
+	if (header != FeatureCacheHeader || device != "device " + std::to_string (major) + " " + std::to_string (minor) + " " + name ()) {
+		Log::debug ("feature") << "Ignoring feature cache for another device." << std::endl;
+		return;
+	}
+	std::ostringstream expected_count;
+	expected_count << "count " << std::hex << *_feature_count;
+	if (count_line != expected_count.str ()) {
+		Log::info ("feature") << "Ignoring feature cache, the feature count changed." << std::endl;
+		return;
+	}
+	std::map<uint16_t, uint8_t> features;
+	unsigned int id, index;
+	while (file >> std::hex >> id >> index) {
+		if (id > 0xffff || index > 0xff) {
+			Log::warning ("feature").printf ("Invalid feature cache %s\n", path.c_str ());
+			return;
+		}
+		features.emplace (id, index);
+	}
+	if (!file.eof ()) {
+		Log::warning ("feature").printf ("Invalid feature cache %s\n", path.c_str ());
+		return;
+	}
+	_cached_features = std::move (features);
+	Log::debug ("feature").printf ("Loaded %zu feature indices from %s\n",
+			_cached_features.size (), path.c_str ());
+}
+
+void Device::saveFeatureCache ()
+{
+	auto path = featureCachePath ();
+	if (path.empty ())
+		return;
+	_feature_cache_dirty = false;
+	if (!_feature_count)
+		_feature_count = readFeatureCount ();
+	auto features = _cached_features;
+	for (const auto &[id, index]: _features)
+		features[id] = index;
+	auto [major, minor] = protocolVersion ();
+	std::ostringstream out;
+	out << FeatureCacheHeader << "\n";
+	out << "device " << major << " " << minor << " " << name () << "\n";
+	out << std::hex;
+	out << "count " << *_feature_count << "\n";
+	for (const auto &[id, index]: features)
+		if (index != 0) // unsupported features are not saved, the device would never correct them
+			out << id << " " << unsigned (index) << "\n";
+	PersistentCache::write (path, out.str ());
 }
@@ -20,18 +20,28 @@
 #define LIBHIDPP_HIDPP20_DEVICE_H
 
 #include <hidpp/Device.h>
+#include <hidpp/Dispatcher.h>
+#include <hidpp20/FeatureTable.h>
+#include <hidpp20/FunctionDescriptor.h>
 
-namespace HIDPP { class Dispatcher; }
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
 
 namespace HIDPP20 {
 
 class Device: public HIDPP::Device
 {
 public:
-	static unsigned int softwareID;
 	Device (HIDPP::Dispatcher *dispatcher, HIDPP::DeviceIndex device_index = HIDPP::DefaultDevice);
 	Device (HIDPP::Device &&other);
+	~Device ();
 
+	/**
+	 * Call a function and wait for its results.
+	 */
 	std::vector<uint8_t> callFunction (uint8_t feature_index,
 					   unsigned int function,
 					   std::vector<uint8_t>::const_iterator param_begin,
@@ -43,6 +53,173 @@ public:
 	{
 		return callFunction (feature_index, function, params.begin (), params.end ());
 	}
+
+	/**
+	 * Call a function and wait for its results without allocating memory.
+	 *
+	 * The response parameters are copied to \p results and truncated if
+	 * it is too short. The remaining bytes of \p results are set to zero.
+	 *
+	 * \sa sendRequest
+	 *
+	 * \returns the number of bytes copied to \p results.
+	 */
+	std::size_t callFunction (uint8_t feature_index,
+				  unsigned int function,
+				  std::span<const uint8_t> params,
+				  std::span<uint8_t> results);
+
+	/**
+	 * Call the function described by \p F (see FunctionDescriptor) and wait for its results.
+	 *
+	 * \p args are encoded directly in the request report and the
+	 * results are decoded from the response report.
+	 *
+	 * \returns a tuple of the values described by F::Results.
+	 * \throws HIDPP::Report::InvalidReportLength if the response is too short.
+	 */
+	template<typename F, typename... Args>
+	typename F::Results::values_type call (uint8_t feature_index, const Args &... args)
+	{
+		auto request = makeRequest (feature_index, F::id, F::Params::size);
+		F::Params::encode (request.parameterBegin (), args...);
+		auto response = sendRequest (std::move (request));
+		if (response.parameterLength () < F::Results::size)
+			throw HIDPP::Report::InvalidReportLength ();
+		return F::Results::decode (response.parameterBegin ());
+	}
+
+	/**
+	 * Build a request for \p function with zeroed parameters.
+	 *
+	 * The smallest report type fitting \p param_length bytes is used
+	 * and the next software ID of this feature is assigned to it.
+	 */
+	HIDPP::Report makeRequest (uint8_t feature_index,
+				   unsigned int function,
+				   std::size_t param_length);
+
+	/**
+	 * Send \p request (see makeRequest) and wait for the response report.
+	 *
+	 * The response is received through the callback interface of the
+	 * dispatcher, no memory is allocated. Kept answers of queries to the
+	 * same feature are discarded (see sendQuery).
+	 *
+	 * \throws Error if the device answered with an error report.
+	 */
+	HIDPP::Report sendRequest (HIDPP::Report &&request);
+
+	/**
+	 * Send the read-only request \p request (see makeRequest) and wait for
+	 * the response report.
+	 *
+	 * Identical queries in flight, from other threads or Device objects
+	 * using the same dispatcher, share a single request and answer (see
+	 * HIDPP::Dispatcher::sendQuery). An answer received less than
+	 * queryMaxAge ago may be returned instead of sending the request.
+	 *
+	 * \throws Error if the device answered with an error report.
+	 */
+	HIDPP::Report sendQuery (HIDPP::Report &&request);
+
+	/**
+	 * Call a read-only function through sendQuery, the results are
+	 * copied like callFunction.
+	 */
+	std::size_t queryFunction (uint8_t feature_index,
+				   unsigned int function,
+				   std::span<const uint8_t> params,
+				   std::span<uint8_t> results);
+
+	/**
+	 * Maximum age of the kept answers used by sendQuery, answers are
+	 * not kept when it is zero (the default).
+	 */
+	std::chrono::milliseconds queryMaxAge () const;
+	void setQueryMaxAge (std::chrono::milliseconds max_age);
+
+	/**
+	 * Send a function call without waiting for the results.
+	 *
+	 * Each call uses the next software ID for this feature (see
+	 * HIDPP::Dispatcher::nextSoftwareID), several calls can be
+	 * pipelined and their responses are matched by software ID.
+	 *
+	 * \returns object for retrieving the response report.
+	 */
+	std::unique_ptr<HIDPP::Dispatcher::AsyncReport> callFunctionAsync (
+			uint8_t feature_index,
+			unsigned int function,
+			std::vector<uint8_t>::const_iterator param_begin,
+			std::vector<uint8_t>::const_iterator param_end);
+
+	inline std::unique_ptr<HIDPP::Dispatcher::AsyncReport> callFunctionAsync (
+			uint8_t feature_index,
+			unsigned int function,
+			const std::vector<uint8_t> &params = {})
+	{
+		return callFunctionAsync (feature_index, function, params.begin (), params.end ());
+	}
+
+	/**
+	 * Get the index of the feature \p feature_id, 0 if it is not supported.
+	 *
+	 * Indices are asked to IRoot once and cached in this object. When
+	 * persistent caches are enabled (see PersistentCache), they are also
+	 * saved to a file and loaded by the next instance for a device with the
+	 * same vendor and product IDs, name, protocol version and feature
+	 * count, that does not need to ask the device again. Checking the
+	 * feature count costs two requests when the file is loaded.
+	 *
+	 * The file is written when this object is destroyed, or at once by
+	 * enumerateFeatures.
+	 */
+	uint8_t getFeatureIndex (uint16_t feature_id);
+
+	/**
+	 * Read the whole feature table of the device.
+	 *
+	 * GetFeatureID requests are pipelined: up to
+	 * HIDPP::Dispatcher::SoftwareIDCount requests are in flight at once
+	 * instead of waiting for each answer before sending the next request.
+	 *
+	 * The table is read only once. It is then used by getFeatureIndex
+	 * (and so by every feature interface constructed afterwards) and
+	 * saved in the persistent cache.
+	 *
+	 * \throws UnsupportedFeature if the device does not support IFeatureSet.
+	 */
+	std::shared_ptr<const FeatureTable> enumerateFeatures ();
+
+	/**
+	 * Discard the feature indices loaded from the persistent cache.
+	 *
+	 * Call it when the device rejects a cached index (e.g. its firmware
+	 * was updated). Indices asked to the device by this object are kept
+	 * and the cache file will be rewritten with only them.
+	 */
+	void invalidateFeatureCache ();
+
+private:
+	static void logRequest (const HIDPP::Report &request);
+	HIDPP::Report waitResponse (HIDPP::Report &&request, bool query);
+
+	void loadFeatureCache ();
+	void saveFeatureCache ();
+	std::string featureCachePath () const;
+	/**
+	 * Ask the feature count to IFeatureSet, 0 if it is not supported.
+	 */
+	unsigned int readFeatureCount ();
+
+	bool _feature_cache_loaded;
+	bool _feature_cache_dirty;
+	std::optional<unsigned int> _feature_count;
+	std::map<uint16_t, uint8_t> _features; // asked to the device
+	std::map<uint16_t, uint8_t> _cached_features; // loaded from the cache file
+	std::shared_ptr<const FeatureTable> _feature_table;
+	std::chrono::milliseconds _query_max_age;
 };
 
 }
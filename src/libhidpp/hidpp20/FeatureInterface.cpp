@@ -19,7 +19,6 @@
 #include "FeatureInterface.h"
 
 #include <hidpp20/Device.h>
-#include <hidpp20/IRoot.h>
 #include <hidpp20/UnsupportedFeature.h>
 #include <misc/Log.h>
 
@@ -27,7 +26,8 @@ using namespace HIDPP20;
 
 FeatureInterface::FeatureInterface (Device *dev, uint16_t id, const char *name):
 	_dev (dev),
-	_index (IRoot (dev).getFeature (id))
+	_id (id),
+	_index (dev->getFeatureIndex (id))
 {
 	if (_index == 0) {
 		Log::info ("feature").printf ("Feature [0x%04hx] %s is not supported\n", id, name);
@@ -46,3 +46,14 @@ uint8_t FeatureInterface::index () const
 	return _index;
 }
 
+bool FeatureInterface::refreshIndex ()
+{
+	_dev->invalidateFeatureCache ();
+	uint8_t index = _dev->getFeatureIndex (_id);
+	if (index == 0 || index == _index)
+		return false;
+	Log::info ("feature").printf ("Feature [0x%04hx] moved to index 0x%02hhx\n", _id, index);
+	_index = index;
+	return true;
+}
+
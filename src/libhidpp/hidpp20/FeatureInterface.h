@@ -20,8 +20,11 @@
 #define LIBHIDPP_HIDPP20_FEATURE_INTERFACE_H
 
 #include <hidpp20/Device.h>
+#include <hidpp20/Error.h>
 
+#include <array>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 namespace HIDPP20
@@ -36,14 +39,95 @@ public:
 
 	uint8_t index () const;
 
+	/**
+	 * Call \p function of this feature.
+	 *
+	 * If the device rejects the feature index because it came from an
+	 * outdated persistent cache, the index is asked again to the device
+	 * and the call is retried once.
+	 */
 	template<typename... Params>
-	std::vector<uint8_t> call (unsigned int function, Params... params)
+	requires requires (Device *dev, Params &... params) {
+		dev->callFunction (0, 0, params...);
+	}
+	auto call (unsigned int function, Params &&... params)
 	{
+		try {
+			return _dev->callFunction (_index, function, params...);
+		}
+		catch (Error &e) {
+			if (e.errorCode () != Error::InvalidFeatureIndex || !refreshIndex ())
+				throw;
+		}
 		return _dev->callFunction (_index, function, params...);
 	}
 
+	/**
+	 * Call the function described by \p F (see FunctionDescriptor) of this
+	 * feature (see Device::call).
+	 *
+	 * Stale feature indices are handled like the other overloads.
+	 */
+	template<typename F, typename... Args>
+	typename F::Results::values_type call (const Args &... args)
+	{
+		try {
+			return _dev->call<F> (_index, args...);
+		}
+		catch (Error &e) {
+			if (e.errorCode () != Error::InvalidFeatureIndex || !refreshIndex ())
+				throw;
+		}
+		return _dev->call<F> (_index, args...);
+	}
+
+	/**
+	 * Call \p function without parameters, the results are copied to
+	 * \p results (see Device::callFunction).
+	 */
+	std::size_t call (unsigned int function, std::span<uint8_t> results)
+	{
+		return call (function, std::span<const uint8_t> (), results);
+	}
+
+	/**
+	 * Call the read-only \p function of this feature, identical calls in
+	 * flight share the same answer (see Device::queryFunction).
+	 *
+	 * Stale feature indices are handled like call.
+	 */
+	std::size_t query (unsigned int function, std::span<const uint8_t> params, std::span<uint8_t> results)
+	{
+		try {
+			return _dev->queryFunction (_index, function, params, results);
+		}
+		catch (Error &e) {
+			if (e.errorCode () != Error::InvalidFeatureIndex || !refreshIndex ())
+				throw;
+		}
+		return _dev->queryFunction (_index, function, params, results);
+	}
+
+	std::size_t query (unsigned int function, std::span<uint8_t> results)
+	{
+		return query (function, std::span<const uint8_t> (), results);
+	}
+
+	/**
+	 * Inline buffer for function results.
+	 */
+	typedef std::array<uint8_t, HIDPP::LongParamLength> results_type;
+
 private:
+	/**
+	 * Invalidate the device feature cache and update the index.
+	 *
+	 * \returns true if the index changed.
+	 */
+	bool refreshIndex ();
+
 	Device *_dev;
+	uint16_t _id;
 	uint8_t _index;
 };
 
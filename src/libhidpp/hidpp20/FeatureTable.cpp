@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "FeatureTable.h"
+
+using namespace HIDPP20;
+
+FeatureTable::FeatureTable (std::vector<Feature> &&features):
+	_features (std::move (features))
+{
+	for (std::size_t i = 1; i < _features.size (); ++i)
+		_indices.emplace (_features[i].id, i);
+}
+
+std::size_t FeatureTable::size () const
+{
+	return _features.size ();
+}
+
+const FeatureTable::Feature &FeatureTable::operator[] (uint8_t index) const
+{
+	return _features[index];
+}
+
+uint8_t FeatureTable::index (uint16_t id) const
+{
+	auto it = _indices.find (id);
+	if (it == _indices.end ())
+		return 0;
+	return it->second;
+}
+
+FeatureTable::const_iterator FeatureTable::begin () const
+{
+	return _features.begin ();
+}
+
+FeatureTable::const_iterator FeatureTable::end () const
+{
+	return _features.end ();
+}
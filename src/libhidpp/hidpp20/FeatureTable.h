@@ -0,0 +1,75 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LIBHIDPP_HIDPP20_FEATURE_TABLE_H
+#define LIBHIDPP_HIDPP20_FEATURE_TABLE_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace HIDPP20
+{
+
+/**
+ * Immutable copy of the feature table of a device.
+ *
+ * \sa Device::enumerateFeatures
+ */
+class FeatureTable
+{
+public:
+	struct Feature
+	{
+		uint16_t id;
+		bool obsolete, hidden, internal;
+		uint8_t version;
+	};
+	typedef std::vector<Feature>::const_iterator const_iterator;
+
+	/**
+	 * Build the table from the features ordered by index, \p features[0]
+	 * is IRoot.
+	 */
+	FeatureTable (std::vector<Feature> &&features);
+
+	/**
+	 * Number of features including IRoot.
+	 */
+	std::size_t size () const;
+
+	/**
+	 * Access the feature at \p index, it must be less than size().
+	 */
+	const Feature &operator[] (uint8_t index) const;
+
+	/**
+	 * Get the index of the feature \p id, 0 if it is not supported.
+	 */
+	uint8_t index (uint16_t id) const;
+
+	const_iterator begin () const;
+	const_iterator end () const;
+
+private:
+	std::vector<Feature> _features;
+	std::map<uint16_t, uint8_t> _indices;
+};
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBHIDPP_HIDPP20_FUNCTION_DESCRIPTOR_H
+#define LIBHIDPP_HIDPP20_FUNCTION_DESCRIPTOR_H
+
+#include <hidpp/Field.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+namespace HIDPP20
+{
+
+/**
+ * Parameter or result of a feature function.
+ *
+ * Values of type \p T are stored at byte \p offset with byte order \p BO.
+ * Enums and bool are stored as integers of the same size. Encoding and
+ * decoding are resolved at compile time and work directly on the report
+ * buffer.
+ *
+ * \sa FunctionDescriptor
+ */
+template<typename T, unsigned int Offset, HIDPP::ByteOrder BO = HIDPP::Undefined>
+struct ParamField
+{
+	typedef T value_type;
+	static constexpr unsigned int offset = Offset;
+	static constexpr unsigned int end = Offset + sizeof (T);
+
+	static_assert (sizeof (T) == 1 || BO != HIDPP::Undefined,
+		       "Byte order is needed for multi-byte parameters");
+
+	template<typename Iterator>
+	static constexpr T read (Iterator data)
+	{
+		storage_type value = 0;
+		for (unsigned int i = 0; i < sizeof (T); ++i)
+			value |= storage_type (data[Offset+i]) << (8*shift (i));
+		return static_cast<T> (value);
+	}
+
+	template<typename Iterator>
+	static constexpr void write (Iterator data, T value)
+	{
+		auto v = static_cast<storage_type> (value);
+		for (unsigned int i = 0; i < sizeof (T); ++i)
+			data[Offset+i] = static_cast<uint8_t> (v >> (8*shift (i)));
+	}
+
+private:
+	typedef std::conditional_t<sizeof (T) == 1, uint8_t,
+		std::conditional_t<sizeof (T) == 2, uint16_t,
+		std::conditional_t<sizeof (T) == 4, uint32_t, uint64_t>>> storage_type;
+
+	static constexpr unsigned int shift (unsigned int i)
+	{
+		return BO == HIDPP::LittleEndian ? i : sizeof (T)-1-i;
+	}
+};
+
+/**
+ * Single bit flag of a feature function parameter or result.
+ *
+ * The flag is bit \p bit of the byte at \p offset, other bits of the byte
+ * are left unchanged when writing.
+ *
+ * \sa FunctionDescriptor
+ */
+template<unsigned int Offset, unsigned int Bit>
+struct FlagField
+{
+	typedef bool value_type;
+	static constexpr unsigned int offset = Offset;
+	static constexpr unsigned int end = Offset + 1;
+
+	static_assert (Bit < 8);
+
+	template<typename Iterator>
+	static constexpr bool read (Iterator data)
+	{
+		return data[Offset] & (1u << Bit);
+	}
+
+	template<typename Iterator>
+	static constexpr void write (Iterator data, bool value)
+	{
+		data[Offset] = (data[Offset] & ~(1u << Bit)) | (unsigned (value) << Bit);
+	}
+};
+
+/**
+ * Layout of the parameters or results of a feature function.
+ *
+ * \p Fields are ParamField or FlagField types. Values are passed to encode and
+ * returned by decode in the order of \p Fields.
+ */
+template<typename... Fields>
+struct FieldLayout
+{
+	/**
+	 * Minimum size of the buffer.
+	 */
+	static constexpr unsigned int size = std::max ({ 0u, Fields::end... });
+
+	typedef std::tuple<typename Fields::value_type...> values_type;
+
+	template<typename Iterator>
+	static constexpr void encode ([[maybe_unused]] Iterator data, const typename Fields::value_type &... values)
+	{
+		(Fields::write (data, values), ...);
+	}
+
+	template<typename Iterator>
+	static constexpr values_type decode ([[maybe_unused]] Iterator data)
+	{
+		return values_type (Fields::read (data)...);
+	}
+};
+
+/**
+ * Compile-time description of a feature function.
+ *
+ * \p ParamLayout and \p ResultLayout are FieldLayout types describing how the
+ * function parameters and results are stored in the reports.
+ *
+ * For example, IRoot::GetFeature takes a big endian feature ID and returns
+ * the feature index followed by a flag byte:
+ * \code
+ * typedef FunctionDescriptor<0,
+ *	FieldLayout<ParamField<uint16_t, 0, HIDPP::BigEndian>>,
+ *	FieldLayout<ParamField<uint8_t, 0>, FlagField<1, 7>, FlagField<1, 6>>> GetFeature;
+ * \endcode
+ *
+ * Such descriptors are called with Device::call or FeatureInterface::call.
+ */
+template<unsigned int ID, typename ParamLayout = FieldLayout<>, typename ResultLayout = FieldLayout<>>
+struct FunctionDescriptor
+{
+	static constexpr unsigned int id = ID;
+	typedef ParamLayout Params;
+	typedef ResultLayout Results;
+};
+
+}
+
+#endif
@@ -31,8 +31,8 @@ IAdjustableDPI::IAdjustableDPI (Device *dev):
 
 unsigned int IAdjustableDPI::getSensorCount ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetSensorCount);
+	results_type results;
+	call (GetSensorCount, results);
 	return results[0];
 }
 
@@ -40,14 +40,14 @@ bool IAdjustableDPI::getSensorDPIList (unsigned int index,
 				       std::vector<unsigned int> &dpi_list,
 				       unsigned int &dpi_step)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = index;
-	results = call (GetSensorDPIList, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (index) };
+	results_type results;
+	call (GetSensorDPIList, params, results);
 	dpi_list.clear ();
 	bool has_dpi_step = false;
 	uint16_t value;
 	auto current = results.begin () + 1;
-	while ((value = readBE<uint16_t> (current)) != 0) {
+	while (current+1 < results.end () && (value = readBE<uint16_t> (current)) != 0) {
 		if (value > 0xe000) {
 			has_dpi_step = true;
 			dpi_step = value - 0xe000;
@@ -62,9 +62,9 @@ bool IAdjustableDPI::getSensorDPIList (unsigned int index,
 
 std::tuple<unsigned int, unsigned int> IAdjustableDPI::getSensorDPI (unsigned int index)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = index;
-	results = call (GetSensorDPI, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (index) };
+	results_type results;
+	query (GetSensorDPI, params, results);
 	unsigned int current_dpi = readBE<uint16_t> (results, 1);
 	unsigned int default_dpi = readBE<uint16_t> (results, 3);
 	return std::make_tuple (current_dpi, default_dpi);
@@ -72,9 +72,10 @@ std::tuple<unsigned int, unsigned int> IAdjustableDPI::getSensorDPI (unsigned in
 
 void IAdjustableDPI::setSensorDPI (unsigned int index, unsigned int dpi)
 {
-	std::vector<uint8_t> params (3);
+	std::array<uint8_t, 3> params;
 	params[0] = index;
 	writeBE<uint16_t> (params, 1, dpi);
-	call (SetSensorDPI, params);
+	results_type results;
+	call (SetSensorDPI, params, results);
 }
 
@@ -64,6 +64,9 @@ public:
 			       unsigned int &dpi_step);
 
 	/**
+	 * Identical calls in flight share the same request (see
+	 * FeatureInterface::query).
+	 *
 	 * \param[in]	index	Sensor index
 	 *
 	 * \returns the current and default DPI values.
@@ -30,13 +30,15 @@ IBatteryLevelStatus::IBatteryLevelStatus (Device *dev):
 
 IBatteryLevelStatus::LevelStatus IBatteryLevelStatus::getLevelStatus ()
 {
-	auto results = call (GetBatteryLevelStatus);
-	return parseLevelStatus (results.begin ());
+	results_type results;
+	query (GetBatteryLevelStatus, results);
+	return parseLevelStatus (results);
 }
 
 IBatteryLevelStatus::Capability IBatteryLevelStatus::getCapability ()
 {
-	auto results = call (GetBatteryCapability);
+	results_type results;
+	call (GetBatteryCapability, results);
 	return Capability {
 		results[0], // number of levels
 		results[1], // flags
@@ -48,14 +50,14 @@ IBatteryLevelStatus::Capability IBatteryLevelStatus::getCapability ()
 IBatteryLevelStatus::LevelStatus IBatteryLevelStatus::batteryLevelEvent (const HIDPP::Report &event)
 {
 	assert (event.function () == BatteryLevelEvent);
-	return parseLevelStatus (event.parameterBegin ());
+	return parseLevelStatus (event.parameters ());
 }
 
-IBatteryLevelStatus::LevelStatus IBatteryLevelStatus::parseLevelStatus (std::vector<uint8_t>::const_iterator params)
+IBatteryLevelStatus::LevelStatus IBatteryLevelStatus::parseLevelStatus (std::span<const uint8_t> params)
 {
 	return LevelStatus {
-		*(params + 0), // level
-		*(params + 1), // next level
-		static_cast<Status>(*(params + 2)), // status
+		params[0], // level
+		params[1], // next level
+		static_cast<Status>(params[2]), // status
 	};
 }
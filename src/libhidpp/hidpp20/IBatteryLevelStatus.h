@@ -87,7 +87,7 @@ public:
 	static LevelStatus batteryLevelEvent (const HIDPP::Report &event);
 
 private:
-	static LevelStatus parseLevelStatus (std::vector<uint8_t>::const_iterator params);
+	static LevelStatus parseLevelStatus (std::span<const uint8_t> params);
 };
 
 }
@@ -18,8 +18,6 @@
 
 #include <hidpp20/IFeatureSet.h>
 
-#include <misc/Endian.h>
-
 using namespace HIDPP20;
 
 constexpr uint16_t IFeatureSet::ID;
@@ -31,9 +29,8 @@ IFeatureSet::IFeatureSet (Device *dev):
 
 unsigned int IFeatureSet::getCount ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetCount);
-	return results[0];
+	auto [count] = call<GetCountFunction> ();
+	return count;
 }
 
 uint16_t IFeatureSet::getFeatureID (uint8_t feature_index,
@@ -42,17 +39,16 @@ uint16_t IFeatureSet::getFeatureID (uint8_t feature_index,
 				    bool *internal,
 				    uint8_t *version)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = feature_index;
-	results = call (GetFeatureID, params);
+	auto [id, is_obsolete, is_hidden, is_internal, feature_version] =
+		call<GetFeatureIDFunction> (feature_index);
 	if (obsolete)
-		*obsolete = results[2] & (1<<7);
+		*obsolete = is_obsolete;
 	if (hidden)
-		*hidden = results[2] & (1<<6);
+		*hidden = is_hidden;
 	if (internal)
-		*internal = results[2] & (1<<5);
+		*internal = is_internal;
 	if (version)
-		*version = results[3];
-	return readBE<uint16_t> (results, 0);
+		*version = feature_version;
+	return id;
 }
 
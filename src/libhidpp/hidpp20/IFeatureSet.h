@@ -34,6 +34,18 @@ public:
 		GetFeatureID = 1,
 	};
 
+	typedef FunctionDescriptor<GetCount,
+		FieldLayout<>,
+		FieldLayout<ParamField<uint8_t, 0>>> GetCountFunction;
+	/**
+	 * Feature index to ID, flags (obsolete, hidden, internal) and version.
+	 */
+	typedef FunctionDescriptor<GetFeatureID,
+		FieldLayout<ParamField<uint8_t, 0>>,
+		FieldLayout<ParamField<uint16_t, 0, HIDPP::BigEndian>,
+		            FlagField<2, 7>, FlagField<2, 6>, FlagField<2, 5>,
+		            ParamField<uint8_t, 3>>> GetFeatureIDFunction;
+
 	IFeatureSet (Device *dev);
 
 	unsigned int getCount ();
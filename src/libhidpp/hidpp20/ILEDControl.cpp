@@ -33,16 +33,16 @@ ILEDControl::ILEDControl (Device *dev):
 
 unsigned int ILEDControl::getCount()
 {
-	std::vector<uint8_t> results;
-	results = call (GetCount);
+	results_type results;
+	call (GetCount, results);
 	return results[0];
 }
 
 ILEDControl::Info ILEDControl::getInfo(unsigned int led_index)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = led_index;
-	results = call (GetInfo, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (led_index) };
+	results_type results;
+	call (GetInfo, params, results);
 	return Info {
 		static_cast<Type> (results[1]), // type
 		results[2], // physical count
@@ -53,23 +53,23 @@ ILEDControl::Info ILEDControl::getInfo(unsigned int led_index)
 
 bool ILEDControl::getSWControl()
 {
-	std::vector<uint8_t> results;
-	results = call (GetSWControl);
+	results_type results;
+	call (GetSWControl, results);
 	return results[0];
 }
 
 void ILEDControl::setSWControl(bool software_controlled)
 {
-	std::vector<uint8_t> params (1);
-	params[0] = software_controlled ? 0x01 : 0x00;
-	call (SetSWControl, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (software_controlled ? 0x01 : 0x00) };
+	results_type results;
+	call (SetSWControl, params, results);
 }
 
 ILEDControl::State ILEDControl::getState(unsigned int led_index)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = led_index;
-	results = call (GetState, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (led_index) };
+	results_type results;
+	call (GetState, params, results);
 	State state { static_cast<Mode> (readLE<uint16_t> (results, 1)) };
 	switch (state.mode) {
 	case On:
@@ -96,7 +96,7 @@ ILEDControl::State ILEDControl::getState(unsigned int led_index)
 
 void ILEDControl::setState(unsigned int led_index, const State &state)
 {
-	std::vector<uint8_t> params (9);
+	std::array<uint8_t, 9> params = {};
 	params[0] = led_index;
 	writeLE<uint16_t> (params, 1, state.mode);
 	switch (state.mode) {
@@ -119,22 +119,22 @@ void ILEDControl::setState(unsigned int led_index, const State &state)
 	default:
 		break;
 	}
-	call (SetState, params);
+	results_type results;
+	call (SetState, params, results);
 }
 
 ILEDControl::Config ILEDControl::getConfig(unsigned int led_index)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = led_index;
-	results = call (GetConfig, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (led_index) };
+	results_type results;
+	call (GetConfig, params, results);
 	return static_cast<Config> (results[1]);
 }
 
 void ILEDControl::setConfig(unsigned int led_index, Config config)
 {
-	std::vector<uint8_t> params (2);
-	params[0] = led_index;
-	params[1] = config;
-	call (SetConfig, params);
+	std::array<uint8_t, 2> params = { static_cast<uint8_t> (led_index), config };
+	results_type results;
+	call (SetConfig, params, results);
 }
 
@@ -32,18 +32,21 @@ IMouseButtonSpy::IMouseButtonSpy (Device *dev):
 
 unsigned int IMouseButtonSpy::getMouseButtonCount ()
 {
-	auto results = call (GetMouseButtonCount);
+	results_type results;
+	call (GetMouseButtonCount, results);
 	return results[0];
 }
 
 void IMouseButtonSpy::startMouseButtonSpy ()
 {
-	call (StartMouseButtonSpy);
+	results_type results;
+	call (StartMouseButtonSpy, results);
 }
 
 void IMouseButtonSpy::stopMouseButtonSpy ()
 {
-	call (StopMouseButtonSpy);
+	results_type results;
+	call (StopMouseButtonSpy, results);
 }
 
 std::vector<uint8_t> IMouseButtonSpy::getMouseButtonMapping ()
@@ -21,6 +21,8 @@
 #include <misc/Endian.h>
 
 #include <cassert>
+#include <deque>
+#include <tuple>
 
 using namespace HIDPP20;
 
@@ -33,90 +35,122 @@ IOnboardProfiles::IOnboardProfiles (Device *dev):
 
 IOnboardProfiles::Description IOnboardProfiles::getDescription ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetDescription);
-	return Description {
-		results[0], // Memory model
-		results[1], // Profile format
-		results[2], // Macro format
-		results[3], results[4], // Profile counts
-		results[5], // Button count
-		results[6], readBE<uint16_t> (results, 7), // Sector (page) count and size
-		results[9], results[10]
-	};
+	return std::make_from_tuple<Description> (call<GetDescriptionFunction> ());
 }
 
 IOnboardProfiles::Mode IOnboardProfiles::getMode ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetMode);
+	results_type results;
+	call (GetMode, results);
 	return static_cast<Mode> (results[0]);
 }
 
 void IOnboardProfiles::setMode (Mode mode)
 {
-	std::vector<uint8_t> params (1);
-	params[0] = static_cast<uint8_t> (mode);
-	call (SetMode, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (mode) };
+	results_type results;
+	call (SetMode, params, results);
 }
 
 std::tuple<IOnboardProfiles::MemoryType, unsigned int> IOnboardProfiles::getCurrentProfile ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetCurrentProfile);
+	results_type results;
+	query (GetCurrentProfile, results);
 	return std::make_tuple (static_cast<MemoryType> (results[0]), results[1]);
 }
 
 void IOnboardProfiles::setCurrentProfile (MemoryType mem_type, unsigned int index)
 {
-	std::vector<uint8_t> params (2);
-	params[0] = mem_type;
-	params[1] = index;
-	call (SetCurrentProfile, params);
+	std::array<uint8_t, 2> params = { mem_type, static_cast<uint8_t> (index) };
+	results_type results;
+	call (SetCurrentProfile, params, results);
 }
 
 std::vector<uint8_t> IOnboardProfiles::memoryRead (MemoryType mem_type, unsigned int page, unsigned int offset)
 {
-	std::vector<uint8_t> params (4), results;
+	std::vector<uint8_t> data (LineSize);
+	memoryRead (mem_type, page, offset, std::span<uint8_t, LineSize> (data));
+	return data;
+}
+
+void IOnboardProfiles::memoryRead (MemoryType mem_type, unsigned int page, unsigned int offset, std::span<uint8_t, LineSize> data)
+{
+	std::array<uint8_t, 4> params;
 	params[0] = mem_type;
 	params[1] = page;
 	writeBE<uint16_t> (params, 2, offset);
-	return call (MemoryRead, params);
+	call (MemoryRead, params, data);
+}
+
+void IOnboardProfiles::memoryReadLines (MemoryType mem_type, unsigned int page, unsigned int offset, std::span<uint8_t> data)
+{
+	std::deque<std::tuple<std::size_t, std::size_t, std::unique_ptr<HIDPP::Dispatcher::AsyncReport>>> pending;
+	std::size_t next = 0;
+	std::vector<uint8_t> params (4);
+	params[0] = mem_type;
+	params[1] = page;
+	while (next < data.size () || !pending.empty ()) {
+		while (next < data.size () && pending.size () < HIDPP::Dispatcher::SoftwareIDCount) {
+			// The last line ends with the data instead of going past it.
+			std::size_t pos = next;
+			if (pos + LineSize > data.size () && data.size () >= LineSize)
+				pos = data.size () - LineSize;
+			writeBE<uint16_t> (params, 2, offset + pos);
+			pending.emplace_back (next, pos, device ()->callFunctionAsync (index (), MemoryRead, params));
+			next += LineSize;
+		}
+		auto &[line, pos, response] = pending.front ();
+		auto report = response->get ();
+		auto length = std::min<std::size_t> (LineSize, data.size () - line);
+		if (report.parameterLength () < line - pos + length)
+			throw HIDPP::Report::InvalidReportLength ();
+		std::copy_n (report.parameterBegin () + (line - pos), length, data.begin () + line);
+		pending.pop_front ();
+	}
 }
 
 void IOnboardProfiles::memoryAddrWrite (unsigned int page, unsigned int offset, unsigned int length)
 {
-	std::vector<uint8_t> params (6);
+	std::array<uint8_t, 6> params;
 	params[0] = MemoryType::Writeable;
 	params[1] = page;
 	writeBE<uint16_t> (params, 2, offset);
 	writeBE<uint16_t> (params, 4, length);
-	call (MemoryAddrWrite, params);
+	results_type results;
+	call (MemoryAddrWrite, params, results);
 }
 
 void IOnboardProfiles::memoryWrite (std::vector<uint8_t>::const_iterator begin, std::vector<uint8_t>::const_iterator end)
 {
 	assert (std::distance (begin, end) <= LineSize);
-	call (MemoryWrite, begin, end);
+	memoryWrite (std::span<const uint8_t> (begin, end));
+}
+
+void IOnboardProfiles::memoryWrite (std::span<const uint8_t> data)
+{
+	assert (data.size () <= LineSize);
+	results_type results;
+	call (MemoryWrite, data, results);
 }
 
 void IOnboardProfiles::memoryWriteEnd ()
 {
-	call (MemoryWriteEnd);
+	results_type results;
+	call (MemoryWriteEnd, results);
 }
 
 unsigned int IOnboardProfiles::getCurrentDPIIndex ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetCurrentDPIIndex);
+	results_type results;
+	call (GetCurrentDPIIndex, results);
 	return results[0];
 }
 
 void IOnboardProfiles::setCurrentDPIIndex (unsigned int index)
 {
-	std::vector<uint8_t> params (1);
-	params[0] = index;
-	call (SetCurrentDPIIndex, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (index) };
+	results_type results;
+	call (SetCurrentDPIIndex, params, results);
 }
 
 std::tuple<IOnboardProfiles::MemoryType, unsigned int> IOnboardProfiles::currentProfileChanged (const HIDPP::Report &event)
@@ -23,6 +23,7 @@
 
 #include <vector>
 #include <array>
+#include <span>
 
 namespace HIDPP20
 {
@@ -120,6 +121,18 @@ public:
 		 */
 		uint8_t various_info;
 	};
+	/**
+	 * Results are stored in the same order as the Description members.
+	 */
+	typedef FunctionDescriptor<GetDescription,
+		FieldLayout<>,
+		FieldLayout<ParamField<uint8_t, 0>, // memory model
+		            ParamField<uint8_t, 1>, // profile format
+		            ParamField<uint8_t, 2>, // macro format
+		            ParamField<uint8_t, 3>, ParamField<uint8_t, 4>, // profile counts
+		            ParamField<uint8_t, 5>, // button count
+		            ParamField<uint8_t, 6>, ParamField<uint16_t, 7, HIDPP::BigEndian>, // sector count and size
+		            ParamField<uint8_t, 9>, ParamField<uint8_t, 10>>> GetDescriptionFunction;
 	/**
 	 * Get information about the mouse formats, capabilities, and other informations.
 	 */
@@ -172,6 +185,9 @@ public:
 	/**
 	 * Get the current profile.
 	 *
+	 * Identical calls in flight share the same request (see
+	 * FeatureInterface::query).
+	 *
 	 * \return the memory type and page of the current profile.
 	 *
 	 * \see setCurrentProfile, currentProfileChanged
@@ -195,6 +211,20 @@ public:
 	 * Read \ref LineSize bytes from the given address.
 	 */
 	std::vector<uint8_t> memoryRead (MemoryType mem_type, unsigned int page, unsigned int offset);
+	/**
+	 * Read \ref LineSize bytes from the given address into \p data.
+	 */
+	void memoryRead (MemoryType mem_type, unsigned int page, unsigned int offset, std::span<uint8_t, LineSize> data);
+	/**
+	 * Read \p data.size () bytes starting at the given address.
+	 *
+	 * Line reads are pipelined: up to HIDPP::Dispatcher::SoftwareIDCount
+	 * reads are in flight and matched by software ID, the data is filled
+	 * as their answers arrive. If the size is not a multiple of
+	 * \ref LineSize, the last line is read \ref LineSize bytes before the
+	 * end so that no read goes past it.
+	 */
+	void memoryReadLines (MemoryType mem_type, unsigned int page, unsigned int offset, std::span<uint8_t> data);
 	/**
 	 * Initiate writing to the memory.
 	 *
@@ -217,6 +247,7 @@ public:
 	 * the extra data at the end of the last memoryWrite call is ignored.
 	 */
 	void memoryWrite (std::vector<uint8_t>::const_iterator begin, std::vector<uint8_t>::const_iterator end);
+	void memoryWrite (std::span<const uint8_t> data);
 	/**
 	 * End writing to the memory.
 	 *
@@ -32,16 +32,16 @@ IReprogControlsV4::IReprogControlsV4 (Device *dev):
 
 unsigned int IReprogControlsV4::getControlCount ()
 {
-	std::vector<uint8_t> results;
-	results = call (GetControlCount);
+	results_type results;
+	call (GetControlCount, results);
 	return results[0];
 }
 
 IReprogControlsV4::ControlInfo IReprogControlsV4::getControlInfo (unsigned int index)
 {
-	std::vector<uint8_t> params (1), results;
-	params[0] = index;
-	results = call (GetControlInfo, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (index) };
+	results_type results;
+	call (GetControlInfo, params, results);
 	ControlInfo ci;
 	ci.control_id = readBE<uint16_t> (results, 0);
 	ci.task_id = readBE<uint16_t> (results, 2);
@@ -55,20 +55,22 @@ IReprogControlsV4::ControlInfo IReprogControlsV4::getControlInfo (unsigned int i
 
 uint16_t IReprogControlsV4::getControlReporting (uint16_t control_id, uint8_t &flags)
 {
-	std::vector<uint8_t> params (2), results;
+	std::array<uint8_t, 2> params;
 	writeBE<uint16_t> (params, 0, control_id);
-	results = call (GetControlReporting, params);
+	results_type results;
+	call (GetControlReporting, params, results);
 	flags = results[2];
 	return readBE<uint16_t> (results, 3);
 }
 
 void IReprogControlsV4::setControlReporting (uint16_t control_id, uint8_t flags, uint16_t remap)
 {
-	std::vector<uint8_t> params (5), results;
+	std::array<uint8_t, 5> params;
 	writeBE<uint16_t> (params, 0, control_id);
 	params[2] = flags;
 	writeBE<uint16_t> (params, 3, remap);
-	call (SetControlReporting, params);
+	results_type results;
+	call (SetControlReporting, params, results);
 }
 
 std::vector<uint16_t> IReprogControlsV4::divertedButtonEvent (const HIDPP::Report &event)
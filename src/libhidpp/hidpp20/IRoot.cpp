@@ -20,8 +20,6 @@
 
 #include <hidpp20/Device.h>
 
-#include <misc/Endian.h>
-
 using namespace HIDPP20;
 
 constexpr uint16_t IRoot::ID;
@@ -35,13 +33,12 @@ uint8_t IRoot::getFeature (uint16_t feature_id,
 			   bool *obsolete,
 			   bool *hidden)
 {
-	std::vector<uint8_t> params (2), results;
-	writeBE<uint16_t> (params, 0, feature_id);
-	results = _dev->callFunction (index, GetFeature, params);
+	auto [feature_index, is_obsolete, is_hidden] =
+		_dev->call<GetFeatureFunction> (index, feature_id);
 	if (obsolete)
-		*obsolete = results[1] & (1<<7);
+		*obsolete = is_obsolete;
 	if (hidden)
-		*hidden = results[1] & (1<<6);
-	return results[0];
+		*hidden = is_hidden;
+	return feature_index;
 }
 
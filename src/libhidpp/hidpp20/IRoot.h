@@ -19,6 +19,8 @@
 #ifndef LIBHIDPP_HIDPP20_IROOT_H
 #define LIBHIDPP_HIDPP20_IROOT_H
 
+#include <hidpp20/FunctionDescriptor.h>
+
 #include <cstdint>
 
 namespace HIDPP20
@@ -37,6 +39,13 @@ public:
 		Ping = 1,
 	};
 
+	/**
+	 * Feature ID to index and flags (obsolete, hidden).
+	 */
+	typedef FunctionDescriptor<GetFeature,
+		FieldLayout<ParamField<uint16_t, 0, HIDPP::BigEndian>>,
+		FieldLayout<ParamField<uint8_t, 0>, FlagField<1, 7>, FlagField<1, 6>>> GetFeatureFunction;
+
 	IRoot (Device *dev);
 
 	uint8_t getFeature (uint16_t feature_id,
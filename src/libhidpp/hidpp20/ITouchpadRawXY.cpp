@@ -32,7 +32,8 @@ ITouchpadRawXY::ITouchpadRawXY (Device *dev):
 
 ITouchpadRawXY::TouchpadInfo ITouchpadRawXY::getTouchpadInfo ()
 {
-	auto results = call (GetTouchpadInfo);
+	results_type results;
+	call (GetTouchpadInfo, results);
 	TouchpadInfo info;
 	info.x_max = readBE<uint16_t> (results, 0);
 	info.y_max = readBE<uint16_t> (results, 2);
@@ -41,9 +42,9 @@ ITouchpadRawXY::TouchpadInfo ITouchpadRawXY::getTouchpadInfo ()
 
 void ITouchpadRawXY::setTouchpadRawMode (bool enable)
 {
-	std::vector<uint8_t> params (1);
-	params[0] = (enable ? 0x01 : 0x00);
-	call (SetTouchpadRawMode, params);
+	std::array<uint8_t, 1> params = { static_cast<uint8_t> (enable ? 0x01 : 0x00) };
+	results_type results;
+	call (SetTouchpadRawMode, params, results);
 }
 
 ITouchpadRawXY::TouchpadRawData ITouchpadRawXY::touchpadRawEvent (const HIDPP::Report &event)
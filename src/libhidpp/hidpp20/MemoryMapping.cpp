@@ -18,16 +18,21 @@
 
 #include "MemoryMapping.h"
 
+#include <hidpp/Dispatcher.h>
+
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdio>
 
 using namespace HIDPP;
 using namespace HIDPP20;
 
-MemoryMapping::MemoryMapping (Device *dev, bool write_crc):
+MemoryMapping::MemoryMapping (Device *dev, bool write_crc, bool partial_writes):
 	AbstractMemoryMapping (write_crc),
 	_iop (dev),
-	_desc (_iop.getDescription ())
+	_desc (_iop.getDescription ()),
+	_partial_writes (partial_writes)
 {
 }
 
@@ -45,7 +50,7 @@ std::vector<uint8_t>::iterator MemoryMapping::getWritableIterator (const Address
 
 bool MemoryMapping::computeOffset (std::vector<uint8_t>::const_iterator it, Address &address)
 {
-	auto &page = getReadOnlyPage (address);
+	auto &page = getPartialPage (address, 0, 0);
 	int dist = distance (page.begin (), it);
 	address.offset = dist;
 	return true;
@@ -54,20 +59,78 @@ bool MemoryMapping::computeOffset (std::vector<uint8_t>::const_iterator it, Addr
 void MemoryMapping::readPage (const Address &address, std::vector<uint8_t> &data)
 {
 	data.resize (_desc.sector_size);
-	for (unsigned int i = 0; i < _desc.sector_size; i += IOnboardProfiles::LineSize) {
-		auto vec = _iop.memoryRead (static_cast<IOnboardProfiles::MemoryType> (address.mem_type), address.page, i);
-		std::copy_n (vec.begin (), IOnboardProfiles::LineSize, &data[i]);
+	_iop.memoryReadLines (static_cast<IOnboardProfiles::MemoryType> (address.mem_type), address.page, 0, data);
+}
+
+std::size_t MemoryMapping::lineSize () const
+{
+	return IOnboardProfiles::LineSize;
+}
+
+std::size_t MemoryMapping::pageSize (const Address &) const
+{
+	return _desc.sector_size;
+}
+
+void MemoryMapping::readLines (const Address &address, std::size_t begin, std::size_t end, std::vector<uint8_t> &data)
+{
+	constexpr size_t LineSize = IOnboardProfiles::LineSize;
+	auto mem_type = static_cast<IOnboardProfiles::MemoryType> (address.mem_type);
+	if (end - begin < LineSize && end >= LineSize) {
+		// Do not read past the end of a sector, read the last
+		// whole line and keep its end.
+		std::array<uint8_t, LineSize> line;
+		_iop.memoryRead (mem_type, address.page, end - LineSize, line);
+		std::copy (line.end () - (end - begin), line.end (), data.begin () + begin);
 	}
+	else
+		_iop.memoryReadLines (mem_type, address.page, begin,
+				      std::span (data).subspan (begin, end - begin));
+}
+
+std::string MemoryMapping::pageCacheName () const
+{
+	auto dev = _iop.device ();
+	char name[32];
+	snprintf (name, sizeof (name), "hidpp20-pages-%04hx-%04hx",
+		  dev->dispatcher ()->vendorID (), dev->productID ());
+	return name;
+}
+
+std::string MemoryMapping::pageCacheIdentity () const
+{
+	// There is no firmware version, the memory layout and the page
+	// CRCs tell if the cached images can be used.
+	auto dev = _iop.device ();
+	auto [major, minor] = dev->protocolVersion ();
+	char identity[64];
+	snprintf (identity, sizeof (identity), "device %u %u memory %u %u %u %u %u ",
+		  major, minor, _desc.memory_model, _desc.profile_format,
+		  _desc.macro_format, _desc.sector_count, _desc.sector_size);
+	return identity + dev->name ();
 }
 
 void MemoryMapping::writePage (const Address &address, const std::vector<uint8_t> &data)
+{
+	writeLines (address, data, 0, _desc.sector_size);
+}
+
+void MemoryMapping::writeRange (const Address &address, const std::vector<uint8_t> &data, std::size_t begin, std::size_t end)
+{
+	if (_partial_writes)
+		writeLines (address, data, begin, end);
+	else
+		writePage (address, data);
+}
+
+void MemoryMapping::writeLines (const Address &address, const std::vector<uint8_t> &data, std::size_t begin, std::size_t end)
 {
 	assert (address.mem_type == IOnboardProfiles::Writeable);
-	_iop.memoryAddrWrite (address.page, address.offset, _desc.sector_size);
 	constexpr size_t LineSize = IOnboardProfiles::LineSize;
-	for (unsigned int i = 0; i < _desc.sector_size; i += LineSize) {
-		_iop.memoryWrite (data.begin () + i, data.begin () + i + LineSize);
+	begin -= begin % LineSize;
+	_iop.memoryAddrWrite (address.page, begin, end - begin);
+	for (std::size_t i = begin; i < end; i += LineSize) {
+		_iop.memoryWrite (data.begin () + i, data.begin () + std::min (i + LineSize, end));
 	}
 	_iop.memoryWriteEnd ();
 }
-
@@ -28,8 +28,15 @@ namespace HIDPP20
 class MemoryMapping: public HIDPP::AbstractMemoryMapping
 {
 public:
-	MemoryMapping (Device *dev, bool write_crc = true);
+	/**
+	 * When \p partial_writes is true, only the lines from the first
+	 * to the last changed byte of a sector are written. It has not
+	 * been verified that every firmware keeps the rest of the sector,
+	 * whole sectors are written by default.
+	 */
+	MemoryMapping (Device *dev, bool write_crc = true, bool partial_writes = false);
 
+	using AbstractMemoryMapping::getReadOnlyIterator;
 	virtual std::vector<uint8_t>::const_iterator getReadOnlyIterator (const HIDPP::Address &address);
 	virtual std::vector<uint8_t>::iterator getWritableIterator (const HIDPP::Address &address);
 	virtual bool computeOffset (std::vector<uint8_t>::const_iterator it, HIDPP::Address &address);
@@ -37,10 +44,19 @@ public:
 protected:
 	virtual void readPage (const HIDPP::Address &address, std::vector<uint8_t> &data);
 	virtual void writePage (const HIDPP::Address &address, const std::vector<uint8_t> &data);
+	virtual void writeRange (const HIDPP::Address &address, const std::vector<uint8_t> &data, std::size_t begin, std::size_t end);
+	virtual std::size_t lineSize () const;
+	virtual std::size_t pageSize (const HIDPP::Address &address) const;
+	virtual void readLines (const HIDPP::Address &address, std::size_t begin, std::size_t end, std::vector<uint8_t> &data);
+	virtual std::string pageCacheName () const;
+	virtual std::string pageCacheIdentity () const;
 
 private:
 	IOnboardProfiles _iop;
 	IOnboardProfiles::Description _desc;
+	bool _partial_writes;
+
+	void writeLines (const HIDPP::Address &address, const std::vector<uint8_t> &data, std::size_t begin, std::size_t end);
 };
 
 }
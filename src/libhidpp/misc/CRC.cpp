@@ -18,23 +18,196 @@
 
 #include <misc/CRC.h>
 
+#include <array>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HIDPP_CRC_CLMUL
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+constexpr uint16_t Polynomial = 0x1021;
+
+/*
+ * Slicing-by-8 tables: Tables[k][i] is the CRC of byte i followed by k
+ * zero bytes, so 8 bytes can be processed with independent lookups.
+ */
+constexpr unsigned int SliceCount = 8;
+typedef std::array<std::array<uint16_t, 256>, SliceCount> table_type;
+
+constexpr table_type makeTables ()
+{
+	table_type tables {};
+	for (unsigned int i = 0; i < 256; ++i) {
+		uint16_t crc = i << 8;
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc & 0x8000 ? (crc << 1) ^ Polynomial : crc << 1);
+		tables[0][i] = crc;
+	}
+	for (unsigned int k = 1; k < SliceCount; ++k) {
+		for (unsigned int i = 0; i < 256; ++i) {
+			uint16_t prev = tables[k-1][i];
+			tables[k][i] = (prev << 8) ^ tables[0][prev >> 8];
+		}
+	}
+	return tables;
+}
+
+constexpr table_type Tables = makeTables ();
+
+uint16_t byteUpdate (uint16_t crc, const uint8_t *data, std::size_t length)
+{
+	while (length-- > 0)
+		crc = (crc << 8) ^ Tables[0][(crc >> 8) ^ *(data++)];
+	return crc;
+}
+
+uint16_t tableUpdate (uint16_t crc, const uint8_t *data, std::size_t length)
+{
+	while (length >= SliceCount) {
+		crc = Tables[7][data[0] ^ (crc >> 8)] ^
+		      Tables[6][data[1] ^ (crc & 0xFF)] ^
+		      Tables[5][data[2]] ^
+		      Tables[4][data[3]] ^
+		      Tables[3][data[4]] ^
+		      Tables[2][data[5]] ^
+		      Tables[1][data[6]] ^
+		      Tables[0][data[7]];
+		data += SliceCount;
+		length -= SliceCount;
+	}
+	return byteUpdate (crc, data, length);
+}
+
+#ifdef HIDPP_CRC_CLMUL
+
+/*
+ * x^n modulo the CRC polynomial.
+ */
+constexpr uint64_t powerMod (unsigned int n)
+{
+	uint32_t r = 1;
+	for (unsigned int i = 0; i < n; ++i) {
+		r <<= 1;
+		if (r & 0x10000)
+			r ^= 0x10000 | Polynomial;
+	}
+	return r;
+}
+
+/*
+ * Minimum length for using carry-less multiplications.
+ */
+constexpr std::size_t ClmulMinimumLength = 64;
+
+/*
+ * Load a block with its bytes reversed, so the first byte holds the
+ * highest polynomial coefficients.
+ */
+__attribute__ ((target ("pclmul,ssse3")))
+inline __m128i load (const uint8_t *data, __m128i reverse)
+{
+	return _mm_shuffle_epi8 (_mm_loadu_si128 (reinterpret_cast<const __m128i *> (data)), reverse);
+}
+
+/*
+ * Fold 16-byte blocks into a 128 bits remainder equivalent to the data
+ * modulo the polynomial: the remainder is multiplied by x^128 (its high
+ * and low halves by x^192 mod P and x^128 mod P) and the next block is
+ * added. The remainder CRC is then computed with the tables.
+ *
+ * \p length must be at least 16.
+ */
+__attribute__ ((target ("pclmul,ssse3")))
+uint16_t clmulUpdate (uint16_t crc, const uint8_t *data, std::size_t length)
+{
+	// Blocks are loaded with the first byte as the highest degree coefficients.
+	const __m128i reverse = _mm_set_epi8 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i k = _mm_set_epi64x (powerMod (192), powerMod (128));
+
+	// The current CRC is added to the first two bytes.
+	__m128i x = _mm_xor_si128 (load (data, reverse), _mm_set_epi64x (static_cast<uint64_t> (crc) << 48, 0));
+	data += 16;
+	length -= 16;
+	while (length >= 16) {
+		x = _mm_xor_si128 (_mm_xor_si128 (_mm_clmulepi64_si128 (x, k, 0x11),
+						   _mm_clmulepi64_si128 (x, k, 0x00)),
+				   load (data, reverse));
+		data += 16;
+		length -= 16;
+	}
+	alignas (16) uint8_t remainder[16];
+	_mm_store_si128 (reinterpret_cast<__m128i *> (remainder), _mm_shuffle_epi8 (x, reverse));
+	crc = tableUpdate (0, remainder, sizeof (remainder));
+	return tableUpdate (crc, data, length);
+}
+
+bool hasClmul ()
+{
+	static const bool supported = __builtin_cpu_supports ("pclmul") &&
+				      __builtin_cpu_supports ("ssse3");
+	return supported;
+}
+
+#endif
+
+}
+
 uint16_t CRC::CCITT (std::vector<uint8_t>::const_iterator begin,
 		     std::vector<uint8_t>::const_iterator end,
 		     uint16_t start_value)
 {
-	uint16_t crc = start_value;
-
-	for (auto it = begin; it != end; ++it) {
-		uint16_t temp = (crc >> 8) ^ *it;
-		crc <<= 8;
-		uint16_t quick = temp ^ (temp >> 4);
-		crc ^= quick;
-		quick <<= 5;
-		crc ^= quick;
-		quick <<= 7;
-		crc ^= quick;
-	}
+	return CCITT (std::span<const uint8_t> (begin, end), start_value);
+}
 
-	return crc;
+uint16_t CRC::CCITT (std::span<const uint8_t> data, uint16_t start_value)
+{
+	return CCITTFinish (CCITTUpdate (CCITTInit (start_value), data));
+}
+
+uint16_t CRC::CCITTUpdate (uint16_t crc, const uint8_t *data, std::size_t length)
+{
+#ifdef HIDPP_CRC_CLMUL
+	if (length >= ClmulMinimumLength && hasClmul ())
+		return clmulUpdate (crc, data, length);
+#endif
+	return tableUpdate (crc, data, length);
+}
+
+bool CRC::isSupported (Implementation impl)
+{
+	switch (impl) {
+	case Implementation::Bytewise:
+	case Implementation::Slicing8:
+		return true;
+	case Implementation::Clmul:
+#ifdef HIDPP_CRC_CLMUL
+		return hasClmul ();
+#else
+		return false;
+#endif
+	}
+	return false;
 }
 
+uint16_t CRC::CCITTUpdate (Implementation impl, uint16_t crc, const uint8_t *data, std::size_t length)
+{
+	switch (impl) {
+	case Implementation::Bytewise:
+		return byteUpdate (crc, data, length);
+	case Implementation::Slicing8:
+		return tableUpdate (crc, data, length);
+	case Implementation::Clmul:
+#ifdef HIDPP_CRC_CLMUL
+		if (length >= 16) // clmulUpdate needs a whole block
+			return clmulUpdate (crc, data, length);
+		return tableUpdate (crc, data, length);
+#else
+		break;
+#endif
+	}
+	throw std::invalid_argument ("unsupported CRC implementation");
+}
@@ -19,17 +19,79 @@
 #ifndef LIBHIDPP_CRC_H
 #define LIBHIDPP_CRC_H
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 namespace CRC
 {
 
+/**
+ * CRC-CCITT (polynomial 0x1021, most significant bit first, no final
+ * xor) of the data between \p begin and \p end.
+ */
 uint16_t CCITT (std::vector<uint8_t>::const_iterator begin,
 		std::vector<uint8_t>::const_iterator end,
 		uint16_t start_value = 0xFFFF);
 
+/**
+ * CRC-CCITT of \p data.
+ */
+uint16_t CCITT (std::span<const uint8_t> data, uint16_t start_value = 0xFFFF);
+
+/**
+ * Incremental CRC-CCITT computation.
+ *
+ * \code
+ * uint16_t crc = CRC::CCITTInit ();
+ * crc = CRC::CCITTUpdate (crc, first_part);
+ * crc = CRC::CCITTUpdate (crc, second_part);
+ * return CRC::CCITTFinish (crc);
+ * \endcode
+ *
+ * Long buffers are processed with carry-less multiplications when the
+ * CPU supports them (checked once at run time), other data with
+ * slicing-by-8 tables.
+ */
+constexpr uint16_t CCITTInit (uint16_t start_value = 0xFFFF)
+{
+	return start_value;
+}
+
+uint16_t CCITTUpdate (uint16_t crc, const uint8_t *data, std::size_t length);
+
+inline uint16_t CCITTUpdate (uint16_t crc, std::span<const uint8_t> data)
+{
+	return CCITTUpdate (crc, data.data (), data.size ());
 }
 
-#endif
+constexpr uint16_t CCITTFinish (uint16_t crc)
+{
+	return crc;
+}
+
+/**
+ * Implementations used by CCITTUpdate, they can be selected explicitly
+ * for comparing them.
+ */
+enum class Implementation
+{
+	Bytewise,	///< One table lookup per byte
+	Slicing8,	///< Slicing-by-8 tables
+	Clmul,		///< Carry-less multiplications (PCLMULQDQ)
+};
+
+/**
+ * Tell if \p impl can be used on this CPU.
+ */
+bool isSupported (Implementation impl);
+
+/**
+ * CCITTUpdate using \p impl, which must be supported.
+ */
+uint16_t CCITTUpdate (Implementation impl, uint16_t crc, const uint8_t *data, std::size_t length);
 
+}
+
+#endif
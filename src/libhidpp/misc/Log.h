@@ -21,6 +21,7 @@
 
 #include <ostream>
 #include <sstream>
+#include <string_view>
 #include <iomanip>
 #include <map>
 #include <algorithm>
@@ -108,7 +109,7 @@ public:
 		;
 
 	template <class InputIterator>
-	void printBytes (const std::string &prefix,
+	void printBytes (std::string_view prefix,
 			 InputIterator begin, InputIterator end) {
 		if (!*this)
 			return;
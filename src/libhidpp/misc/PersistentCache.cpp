@@ -0,0 +1,74 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "PersistentCache.h"
+
+#include <misc/Log.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+
+static std::mutex mutex;
+static std::string cache_directory = [] () {
+	const char *env = std::getenv ("HIDPP_CACHE_DIR");
+	return std::string (env ? env : "");
+} ();
+
+std::string PersistentCache::directory ()
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	return cache_directory;
+}
+
+void PersistentCache::setDirectory (const std::string &dir)
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	cache_directory = dir;
+}
+
+std::string PersistentCache::path (const std::string &name)
+{
+	auto dir = directory ();
+	if (dir.empty ())
+		return {};
+	return (std::filesystem::path (dir) / name).string ();
+}
+
+bool PersistentCache::write (const std::string &path, const std::string &contents)
+{
+	// Unique temporary name, several processes may update the same cache.
+	auto tmp_path = path + "." + std::to_string (std::random_device {} ()) + ".tmp";
+	{
+		std::ofstream file (tmp_path, std::ios::binary | std::ios::trunc);
+		file << contents;
+		if (!file.flush ()) {
+			Log::warning ("cache").printf ("Failed to write cache file %s\n", tmp_path.c_str ());
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename (tmp_path, path, ec);
+	if (ec) {
+		Log::warning ("cache").printf ("Failed to replace cache file %s: %s\n", path.c_str (), ec.message ().c_str ());
+		std::filesystem::remove (tmp_path, ec);
+		return false;
+	}
+	return true;
+}
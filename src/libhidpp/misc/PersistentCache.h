@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LIBHIDPP_PERSISTENT_CACHE_H
+#define LIBHIDPP_PERSISTENT_CACHE_H
+
+#include <string>
+
+/**
+ * Location of the caches kept between program runs.
+ */
+namespace PersistentCache
+{
+
+/**
+ * Get the directory containing persistent caches.
+ *
+ * It is initialized from the HIDPP_CACHE_DIR environment variable.
+ * Persistent caches are disabled when it is empty.
+ */
+std::string directory ();
+void setDirectory (const std::string &dir);
+
+/**
+ * Get the path of the cache file \p name, or an empty string if
+ * persistent caches are disabled.
+ */
+std::string path (const std::string &name);
+
+/**
+ * Replace the cache file \p path with \p contents.
+ *
+ * The file is written to a temporary file first, concurrent readers
+ * see either the old or the new contents.
+ *
+ * \returns false if the file could not be written (the error is logged).
+ */
+bool write (const std::string &path, const std::string &contents);
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <misc/CRC.h>
+
+#include "common/common.h"
+#include "common/Option.h"
+#include "common/CommonOptions.h"
+
+using CRC::Implementation;
+
+static const struct {
+	Implementation impl;
+	const char *name;
+} Implementations[] = {
+	{ Implementation::Bytewise, "bytewise" },
+	{ Implementation::Slicing8, "slicing-by-8" },
+	{ Implementation::Clmul, "pclmul" },
+};
+
+/*
+ * Compare every supported implementation with the bytewise one over
+ * random buffers split at random positions, with random start values.
+ */
+static bool checkImplementations (unsigned int count)
+{
+	std::mt19937 rng (0x1021);
+	std::vector<uint8_t> data;
+	for (unsigned int n = 0; n < count; ++n) {
+		data.resize (std::uniform_int_distribution<std::size_t> (0, 1024) (rng));
+		for (auto &byte: data)
+			byte = rng ();
+		std::size_t split = std::uniform_int_distribution<std::size_t> (0, data.size ()) (rng);
+		uint16_t start = rng ();
+		uint16_t expected = CRC::CCITTUpdate (Implementation::Bytewise, start, data.data (), data.size ());
+		for (const auto &[impl, name]: Implementations) {
+			if (!CRC::isSupported (impl))
+				continue;
+			uint16_t crc = CRC::CCITTUpdate (impl, start, data.data (), split);
+			crc = CRC::CCITTUpdate (impl, crc, data.data () + split, data.size () - split);
+			if (crc != expected) {
+				fprintf (stderr, "%s CRC mismatch for %zu bytes split at %zu (start %04hx): %04hx instead of %04hx\n",
+					 name, data.size (), split, start, crc, expected);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main (int argc, char *argv[])
+{
+	static const char *args = "";
+	unsigned int iterations = 100000;
+	std::size_t size = 512;
+
+	std::vector<Option> options = {
+		Option ('n', "iterations",
+			Option::RequiredArgument, "count",
+			"Number of CRCs computed for each implementation (default: 100000).",
+			[&iterations] (const char *optarg) -> bool {
+				char *endptr;
+				iterations = strtoul (optarg, &endptr, 0);
+				if (*endptr != '\0' || iterations == 0) {
+					fprintf (stderr, "Invalid iteration count: %s\n", optarg);
+					return false;
+				}
+				return true;
+			}),
+		Option ('s', "size",
+			Option::RequiredArgument, "bytes",
+			"Size of the buffer (default: 512, a HID++ 1.0 page).",
+			[&size] (const char *optarg) -> bool {
+				char *endptr;
+				size = strtoul (optarg, &endptr, 0);
+				if (*endptr != '\0' || size == 0) {
+					fprintf (stderr, "Invalid buffer size: %s\n", optarg);
+					return false;
+				}
+				return true;
+			}),
+	};
+	Option help = HelpOption (argv[0], args, &options);
+	options.push_back (help);
+
+	int first_arg;
+	if (!Option::processOptions (argc, argv, options, first_arg))
+		return EXIT_FAILURE;
+
+	if (!checkImplementations (10000))
+		return EXIT_FAILURE;
+
+	std::mt19937 rng (0xFFFF);
+	std::vector<uint8_t> data (size);
+	for (auto &byte: data)
+		byte = rng ();
+
+	uint16_t reference = CRC::CCITTUpdate (Implementation::Bytewise, CRC::CCITTInit (), data.data (), data.size ());
+	for (const auto &[impl, name]: Implementations) {
+		if (!CRC::isSupported (impl)) {
+			printf ("%-14s not supported\n", name);
+			continue;
+		}
+		volatile uint16_t crc = 0; // keep every computation
+		auto start = std::chrono::steady_clock::now ();
+		for (unsigned int i = 0; i < iterations; ++i)
+			crc = CRC::CCITTUpdate (impl, CRC::CCITTInit (), data.data (), data.size ());
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+		if (crc != reference) {
+			fprintf (stderr, "%s CRC mismatch: %04hx instead of %04hx\n", name, uint16_t (crc), reference);
+			return EXIT_FAILURE;
+		}
+		printf ("%-14s %8.1f ns/buffer %8.1f MB/s\n", name,
+			elapsed.count () * 1e9 / iterations,
+			size * iterations / elapsed.count () / 1e6);
+	}
+
+	return EXIT_SUCCESS;
+}
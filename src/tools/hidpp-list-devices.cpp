@@ -23,8 +23,6 @@
 #include <hid/DeviceMonitor.h>
 #include <hidpp/SimpleDispatcher.h>
 #include <hidpp/Device.h>
-#include <hidpp10/Error.h>
-#include <hidpp20/Error.h>
 
 #include "common/common.h"
 #include "common/Option.h"
@@ -37,50 +35,16 @@ protected:
 	{
 		try {
 			HIDPP::SimpleDispatcher dispatcher (path);
-			bool has_receiver_index = false;
-			for (HIDPP::DeviceIndex index: {
-					HIDPP::DefaultDevice,
-					HIDPP::CordedDevice,
-					HIDPP::WirelessDevice1,
-					HIDPP::WirelessDevice2,
-					HIDPP::WirelessDevice3,
-					HIDPP::WirelessDevice4,
-					HIDPP::WirelessDevice5,
-					HIDPP::WirelessDevice6 }) {
-				// Skip wireless devices, if the default index (used by the receiver) already failed.
-				if (!has_receiver_index && index == HIDPP::WirelessDevice1)
-					break;
-				try {
-					HIDPP::Device dev (&dispatcher, index);
-					auto version = dev.protocolVersion ();
-					printf ("%s", path);
-					if (index != HIDPP::DefaultDevice)
-						printf (" (device %d)", index);
-					printf (": %s (%04hx:%04hx) HID++ %d.%d\n",
-							dev.name ().c_str (),
-							dispatcher.hidraw ().vendorID (), dev.productID (),
-							std::get<0> (version), std::get<1> (version));
-					if (index == HIDPP::DefaultDevice && version == std::make_tuple (1, 0))
-						has_receiver_index = true;
-				}
-				catch (HIDPP10::Error &e) {
-					if (e.errorCode () != HIDPP10::Error::UnknownDevice && e.errorCode () != HIDPP10::Error::InvalidSubID) {
-						Log::error ().printf ("Error while querying %s wireless device %d: %s\n",
-								      path, index, e.what ());
-					}
-				}
-				catch (HIDPP20::Error &e) {
-					if (e.errorCode () != HIDPP20::Error::UnknownDevice) {
-						Log::error ().printf ("Error while querying %s device %d: %s\n",
-								      path, index, e.what ());
-					}
-				}
-				catch (HIDPP::Dispatcher::TimeoutError &e) {
-					Log::warning ().printf ("Device %s (index %d) timed out\n",
-								path, index);
-				}
+			for (auto &dev: HIDPP::discoverDevices (&dispatcher)) {
+				auto version = dev.protocolVersion ();
+				printf ("%s", path);
+				if (dev.deviceIndex () != HIDPP::DefaultDevice)
+					printf (" (device %d)", dev.deviceIndex ());
+				printf (": %s (%04hx:%04hx) HID++ %d.%d\n",
+						dev.name ().c_str (),
+						dispatcher.hidraw ().vendorID (), dev.productID (),
+						std::get<0> (version), std::get<1> (version));
 			}
-
 		}
 		catch (HIDPP::Dispatcher::NoHIDPPReportException &e) {
 		}
@@ -24,8 +24,8 @@
 #include <hidpp10/Device.h>
 #include <hidpp10/Error.h>
 #include <hidpp10/IIndividualFeatures.h>
+#include <hidpp10/RegisterBatch.h>
 #include <hidpp20/Device.h>
-#include <hidpp20/IFeatureSet.h>
 #include <misc/Log.h>
 
 #include "common/common.h"
@@ -126,54 +126,57 @@ static const std::map<uint16_t, const char *> HIDPP20Features = {
 	{ 0x8320, "Headset out" },
 };
 
-void testRegister (HIDPP10::Device *dev, std::size_t register_size, uint8_t address, bool test_write = false)
+static void printRegisterError (const char *access, uint8_t address, std::size_t register_size, std::exception_ptr error)
 {
-	std::vector<uint8_t> values (register_size);
-	bool readable = false;
 	try {
-		dev->getRegister (address, nullptr, values);
-		readable = true;
-		printf ("Register 0x%02hhx read  %2lu:", address, register_size);
-		for (uint8_t value: values)
-			printf (" %02hhx", value);
-		printf ("\n");
+		std::rethrow_exception (error);
 	}
 	catch (HIDPP10::Error &e) {
 		if (e.errorCode () != HIDPP10::Error::InvalidSubID &&
 		    e.errorCode () != HIDPP10::Error::InvalidAddress) {
-			printf ("Register 0x%02hhx read  %2lu: %s (0x%02hhx)\n",
-				address, register_size, e.what (), e.errorCode ());
+			printf ("Register 0x%02hhx %s %2lu: %s (0x%02hhx)\n",
+				address, access, register_size, e.what (), e.errorCode ());
 		}
 	}
-	if (test_write) {
-		try {
-			std::vector<uint8_t> results;
-			if (readable) {
-				dev->setRegister (address, values, &results);
-			}
-			else {
-				std::vector<uint8_t> params (register_size);
-				dev->setRegister (address, params, &results);
-			}
-			printf ("Register 0x%02hhx write %2lu:", address, register_size);
-			for (uint8_t value: results)
+	catch (std::system_error &e) {
+		/* G5 does not support long writes and throw EPIPE */
+		if (e.code ().value () != EPIPE) {
+			throw;
+		}
+	}
+}
+
+static void testRegisterWrite (HIDPP10::RegisterBatch &batch, std::size_t register_size, uint8_t address, const std::vector<uint8_t> &values)
+{
+	batch.setRegister (address, values, [register_size, address] (const std::vector<uint8_t> *results, std::exception_ptr error) {
+		if (error) {
+			printRegisterError ("write", address, register_size, error);
+			return;
+		}
+		printf ("Register 0x%02hhx write %2lu:", address, register_size);
+		for (uint8_t value: *results)
+			printf (" %02hhx", value);
+		printf ("\n");
+	});
+}
+
+void testRegister (HIDPP10::RegisterBatch &batch, std::size_t register_size, uint8_t address, bool test_write = false)
+{
+	batch.getRegister (address, register_size, nullptr, [&batch, register_size, address, test_write] (const std::vector<uint8_t> *results, std::exception_ptr error) {
+		if (error)
+			printRegisterError ("read ", address, register_size, error);
+		else {
+			printf ("Register 0x%02hhx read  %2lu:", address, register_size);
+			for (uint8_t value: *results)
 				printf (" %02hhx", value);
 			printf ("\n");
 		}
-		catch (HIDPP10::Error &e) {
-			if (e.errorCode () != HIDPP10::Error::InvalidSubID &&
-			    e.errorCode () != HIDPP10::Error::InvalidAddress) {
-				printf ("Register 0x%02hhx write %2lu: %s (0x%02hhx)\n",
-					address, register_size, e.what (), e.errorCode ());
-			}
-		}
-		catch (std::system_error &e) {
-			/* G5 does not support long writes and throw EPIPE */
-			if (e.code ().value () != EPIPE) {
-				throw e;
-			}
+		if (test_write) {
+			// Write back the read value, or zeroes if the register is not readable.
+			testRegisterWrite (batch, register_size, address,
+					   results ? *results : std::vector<uint8_t> (register_size));
 		}
-	}
+	});
 }
 
 int main (int argc, char *argv[])
@@ -238,10 +241,12 @@ int main (int argc, char *argv[])
 	if (major == 1 && minor == 0) {
 		HIDPP10::Device dev (std::move (gdev));
 
+		HIDPP10::RegisterBatch batch (&dev);
 		for (unsigned int address = 0; address < 256; ++address) {
-			testRegister (&dev, HIDPP::ShortParamLength, static_cast<uint8_t> (address), do_write_tests);
-			testRegister (&dev, HIDPP::LongParamLength, static_cast<uint8_t> (address), do_write_tests);
+			testRegister (batch, HIDPP::ShortParamLength, static_cast<uint8_t> (address), do_write_tests);
+			testRegister (batch, HIDPP::LongParamLength, static_cast<uint8_t> (address), do_write_tests);
 		}
+		batch.run ();
 		if (do_write_tests) {
 			try {
 				HIDPP10::IIndividualFeatures iif (&dev);
@@ -285,25 +290,21 @@ int main (int argc, char *argv[])
 	 */
 	else if (major >= 2) {
 		HIDPP20::Device dev (std::move (gdev));
-		HIDPP20::IFeatureSet ifeatureset (&dev);
+		auto features = dev.enumerateFeatures ();
 
-		unsigned int feature_count = ifeatureset.getCount ();
-		for (unsigned int i = 1; i <= feature_count; ++i) {
+		for (unsigned int i = 1; i < features->size (); ++i) {
 			uint8_t feature_index = i;
-			uint16_t feature_id;
-			bool obsolete, hidden, internal;
-
-			feature_id = ifeatureset.getFeatureID (feature_index, &obsolete, &hidden, &internal);
-			auto str = HIDPP20Features.find (feature_id);
+			const auto &feature = (*features)[feature_index];
+			auto str = HIDPP20Features.find (feature.id);
 			printf ("Feature 0x%02hhx: [0x%04hx] %s",
-				feature_index, feature_id,
+				feature_index, feature.id,
 				(str == HIDPP20Features.end () ? "?" : str->second));
 			std::vector<const char *> flag_strings;
-			if (obsolete)
+			if (feature.obsolete)
 				flag_strings.push_back ("obsolete");
-			if (hidden)
+			if (feature.hidden)
 				flag_strings.push_back ("hidden");
-			if (internal)
+			if (feature.internal)
 				flag_strings.push_back ("internal");
 			if (!flag_strings.empty ()) {
 				printf (" (");
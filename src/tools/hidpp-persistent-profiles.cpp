@@ -47,10 +47,18 @@ int main (int argc, char *argv[])
 {
 	static const char *args = "device_path read|write [file]";
 	HIDPP::DeviceIndex device_index = HIDPP::DefaultDevice;
+	bool page_cache = false;
 
 	std::vector<Option> options = {
 		DeviceIndexOption (device_index),
 		VerboseOption (),
+		Option ('c', "page-cache",
+			Option::NoArgument, "",
+			"Keep page images in the persistent cache directory (HIDPP_CACHE_DIR), only pages changed since the last run are read again.",
+			[&page_cache] (const char *) -> bool {
+				page_cache = true;
+				return true;
+			}),
 	};
 	Option help = HelpOption (argv[0], args, &options);
 	options.push_back (help);
@@ -119,6 +127,9 @@ int main (int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (page_cache && !memory->enablePageCache ())
+		fprintf (stderr, "Page cache is not available: persistent caches are disabled (see HIDPP_CACHE_DIR) or not supported by this device.\n");
+
 	ProfileXML profxml (profile_format.get (), profdir_format.get ());
 
 	if (op == "write") {
@@ -201,7 +212,7 @@ int main (int argc, char *argv[])
 		auto profdir_it = memory->getReadOnlyIterator (dir_address);
 		HIDPP::ProfileDirectory profdir = profdir_format->read (profdir_it);
 		for (const auto &entry: profdir.entries) {
-			auto it = memory->getReadOnlyIterator (entry.profile_address);
+			auto it = memory->getReadOnlyIterator (entry.profile_address, profile_format->size ());
 			HIDPP::Profile profile = profile_format->read (it);
 
 			std::vector<HIDPP::Macro> macros;
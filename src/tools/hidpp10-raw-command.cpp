@@ -95,8 +95,9 @@ int main (int argc, char *argv[])
 			}
 			params.resize (HIDPP::ShortParamLength, 0);
 			results.resize (register_size);
+			// Any register can be accessed, wait without timeout.
 			dev.getRegister (static_cast<uint8_t> (address),
-					 &params, results);
+					 &params, results, false);
 		}
 		else if (type == "write") {
 			if (params.size () > register_size) {
@@ -105,7 +106,7 @@ int main (int argc, char *argv[])
 			}
 			params.resize (register_size, 0);
 			dev.setRegister (static_cast<uint8_t> (address),
-					 params, &results);
+					 params, &results, false);
 		}
 	}
 	catch (HIDPP10::Error &e) {
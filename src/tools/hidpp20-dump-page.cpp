@@ -18,6 +18,7 @@
 
 #include <cstdio>
 #include <memory>
+#include <vector>
 
 #include <hidpp/SimpleDispatcher.h>
 #include <hidpp20/Device.h>
@@ -77,12 +78,9 @@ int main (int argc, char *argv[])
 	try {
 		HIDPP20::IOnboardProfiles iop (&dev);
 		auto desc = iop.getDescription ();
-		unsigned int i = 0;
-		while (i < desc.sector_size) {
-			auto data = iop.memoryRead (mem_type, page, i);
-			fwrite (data.data (), sizeof (uint8_t), data.size (), stdout);
-			i += data.size ();
-		}
+		std::vector<uint8_t> data (desc.sector_size);
+		iop.memoryReadLines (mem_type, page, 0, data);
+		fwrite (data.data (), sizeof (uint8_t), data.size (), stdout);
 	}
 	catch (HIDPP20::Error &e) {
 		fprintf (stderr, "HID++2 error %d: %s\n", e.errorCode (), e.what ());
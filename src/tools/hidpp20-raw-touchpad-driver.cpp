@@ -36,7 +36,7 @@ extern "C" {
 
 #include <misc/Log.h>
 #include <hid/DeviceMonitor.h>
-#include <hidpp/DispatcherThread.h>
+#include <hidpp/DispatcherReactor.h>
 #include <hidpp10/Device.h>
 #include <hidpp10/defs.h>
 #include <hidpp10/IReceiver.h>
@@ -321,30 +321,37 @@ class MyMonitor: public HID::DeviceMonitor
 {
 	struct node
 	{
-		HIDPP::DispatcherThread dispatcher;
-		std::thread thread;
+		HIDPP::DispatcherReactor *reactor;
+		std::shared_ptr<HIDPP::DispatcherThread> dispatcher;
 		std::unique_ptr<Driver> driver;
 
-		node (const char *path):
-			dispatcher (path),
-			thread (std::bind (&HIDPP::DispatcherThread::run, &dispatcher))
+		node (HIDPP::DispatcherReactor *reactor, const char *path):
+			reactor (reactor),
+			dispatcher (reactor->addDevice (path))
 		{
 		}
 
 		~node ()
 		{
 			driver.reset ();
-			dispatcher.stop ();
-			thread.join ();
+			reactor->removeDevice (dispatcher.get ());
 		}
 	};
+	HIDPP::DispatcherReactor *_reactor;
 	std::map<std::string, node> _nodes;
 public:
+	MyMonitor (HIDPP::DispatcherReactor *reactor):
+		_reactor (reactor)
+	{
+	}
+
 	void addDevice (const char *path)
 	{
 		std::map<std::string, node>::iterator it;
 		try {
-			it = _nodes.emplace (path, path).first;
+			it = _nodes.emplace (std::piecewise_construct_t (),
+					     std::make_tuple (path),
+					     std::make_tuple (_reactor, path)).first;
 		}
 		catch (std::exception &e) {
 			Log::debug () << "Ignored device " << path << ": " << e.what () << std::endl;
@@ -352,7 +359,7 @@ public:
 		}
 		auto &node = it->second;
 		try {
-			node.driver = std::make_unique<ReceiverDriver> (&node.dispatcher);
+			node.driver = std::make_unique<ReceiverDriver> (node.dispatcher.get ());
 			return;
 		}
 		catch (std::exception &e) {
@@ -360,7 +367,7 @@ public:
 		}
 		for (HIDPP::DeviceIndex index: { HIDPP::DefaultDevice, HIDPP::CordedDevice }) {
 			try {
-				node.driver = std::make_unique<TouchpadDriver> (&node.dispatcher, index);
+				node.driver = std::make_unique<TouchpadDriver> (node.dispatcher.get (), index);
 				return;
 			}
 			catch (std::exception &e) {
@@ -393,21 +400,29 @@ int main (int argc, char *argv[])
 	if (!Option::processOptions (argc, argv, options, first_arg))
 		return EXIT_FAILURE;
 
-	MyMonitor monitor;
-	std::thread monitor_thread (std::bind (&HID::DeviceMonitor::run, &monitor));
+	HIDPP::DispatcherReactor reactor;
+	std::thread reactor_thread (std::bind (&HIDPP::DispatcherReactor::run, &reactor));
 
-	struct sigaction sa, oldsa;
-	memset (&sa, 0, sizeof (struct sigaction));
-	sa.sa_handler = sigint;
-	sigaction (SIGINT, &sa, &oldsa);
+	{
+		MyMonitor monitor (&reactor);
+		std::thread monitor_thread (std::bind (&HID::DeviceMonitor::run, &monitor));
 
-	while (auto task = task_queue.pop ())
-		task.value () ();
+		struct sigaction sa, oldsa;
+		memset (&sa, 0, sizeof (struct sigaction));
+		sa.sa_handler = sigint;
+		sigaction (SIGINT, &sa, &oldsa);
 
-	sigaction (SIGINT, &oldsa, nullptr);
+		while (auto task = task_queue.pop ())
+			task.value () ();
+
+		sigaction (SIGINT, &oldsa, nullptr);
+
+		monitor.stop ();
+		monitor_thread.join ();
+	}
 
-	monitor.stop ();
-	monitor_thread.join ();
+	reactor.stop ();
+	reactor_thread.join ();
 
 	return EXIT_SUCCESS;
 }
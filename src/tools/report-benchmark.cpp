@@ -0,0 +1,133 @@
+/*
+ * Copyright 2026 Clément Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <hidpp/Report.h>
+
+#include "common/common.h"
+#include "common/Option.h"
+#include "common/CommonOptions.h"
+
+/*
+ * Count the allocations made by the whole program, reports built from
+ * a read buffer must not allocate.
+ */
+static std::atomic<unsigned long> allocations (0);
+
+void *operator new (std::size_t size)
+{
+	++allocations;
+	if (void *p = std::malloc (size ? size : 1))
+		return p;
+	throw std::bad_alloc ();
+}
+
+void operator delete (void *p) noexcept
+{
+	std::free (p);
+}
+
+void operator delete (void *p, std::size_t) noexcept
+{
+	std::free (p);
+}
+
+using HIDPP::Report;
+
+int main (int argc, char *argv[])
+{
+	static const char *args = "";
+	unsigned int iterations = 1000000;
+
+	std::vector<Option> options = {
+		Option ('n', "iterations",
+			Option::RequiredArgument, "count",
+			"Number of reports built for each report type (default: 1000000).",
+			[&iterations] (const char *optarg) -> bool {
+				char *endptr;
+				iterations = strtoul (optarg, &endptr, 0);
+				if (*endptr != '\0' || iterations == 0) {
+					fprintf (stderr, "Invalid iteration count: %s\n", optarg);
+					return false;
+				}
+				return true;
+			}),
+	};
+	Option help = HelpOption (argv[0], args, &options);
+	options.push_back (help);
+
+	int first_arg;
+	if (!Option::processOptions (argc, argv, options, first_arg))
+		return EXIT_FAILURE;
+
+	static const struct {
+		Report::Type type;
+		const char *name;
+	} types[] = {
+		{ Report::Short, "short" },
+		{ Report::Long, "long" },
+		{ Report::VeryLong, "very long" },
+	};
+	bool allocated = false;
+	for (const auto &[type, name]: types) {
+		// Read buffer as filled by RawDevice::readReport: a HID++ 2.0
+		// response from device 1, feature 2, function 3.
+		uint8_t buffer[HIDPP::MaxReportLength] = { 0 };
+		std::size_t length = Report::reportLength (type);
+		buffer[0] = type;
+		buffer[1] = HIDPP::WirelessDevice1;
+		buffer[2] = 0x02;
+		buffer[3] = 0x31;
+		for (std::size_t i = 4; i < length; ++i) // after the header
+			buffer[i] = i;
+
+		std::optional<Report> last;
+		unsigned int sum = 0;
+		auto start_allocations = allocations.load ();
+		auto start = std::chrono::steady_clock::now ();
+		for (unsigned int i = 0; i < iterations; ++i) {
+			buffer[4] = i; // first parameter
+			Report report (std::span<const uint8_t> (buffer, length));
+			uint8_t feature_index, error_code;
+			unsigned int function, sw_id;
+			if (!report.checkErrorMessage20 (&feature_index, &function, &sw_id, &error_code))
+				sum += report.parameters ()[0];
+			last.emplace (std::move (report));
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+		auto count = allocations.load () - start_allocations;
+		printf ("%-10s %8.1f ns/report %10lu allocations (checksum %u)\n", name,
+			elapsed.count () * 1e9 / iterations, count, sum);
+		if (count != 0)
+			allocated = true;
+	}
+	if (allocated) {
+		fprintf (stderr, "Building reports allocated memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}